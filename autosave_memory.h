@@ -3,7 +3,7 @@
 
 #include <pico/platform.h>
 const uint32_t __in_flash() __attribute__((aligned(4096))) autosave_memory[512][16] = {
-{1413000, 0, 3, 3, 30000000, 0, 0, 5, 10, 1920, 62, 18, 0, 268960770, 8405024, 4294967295},
+{1413000, 0, 3, 3, 30000000, 0, 0, 5, 10, 1920, 62, 18, 0, 268960770, 8405024, 1413000},
 {4294967295, 4294967295, 4294967295, 4294967295, 4294967295, 4294967295, 4294967295, 4294967295, 4294967295, 4294967295, 4294967295, 4294967295, 4294967295, 4294967295, 4294967295, 4294967295},
 {4294967295, 4294967295, 4294967295, 4294967295, 4294967295, 4294967295, 4294967295, 4294967295, 4294967295, 4294967295, 4294967295, 4294967295, 4294967295, 4294967295, 4294967295, 4294967295},
 {4294967295, 4294967295, 4294967295, 4294967295, 4294967295, 4294967295, 4294967295, 4294967295, 4294967295, 4294967295, 4294967295, 4294967295, 4294967295, 4294967295, 4294967295, 4294967295},
@@ -87,13 +87,57 @@ void process_cat_control(rx_settings & settings_to_apply, rx_status & status, rx
             }
         }
 
+    } else if (strncmp(cmd, "FB", 2) == 0) {
+
+        // VFO B is the dual watch frequency
+        if (cmd[2] == ';') {
+            printf("FB%011lu;", settings[idx_dual_watch_frequency]);
+        } else {
+            uint32_t frequency_Hz;
+            sscanf(cmd+2, "%lu", &frequency_Hz);
+            if(frequency_Hz <= 30000000)
+            {
+              settings[idx_dual_watch_frequency]=frequency_Hz;
+              settings_changed = true;
+            }
+            else
+            {
+              stdio_puts_raw("?;");
+            }
+        }
+
+    } else if (strncmp(cmd, "DW", 2) == 0) {
+
+        // Dual watch, 0 = off, 1 = on usb audio, 2 = mixed with the main channel
+        if (cmd[2] == ';') {
+            printf("DW%lu;", (settings[idx_rx_features] & mask_dual_watch) >> flag_dual_watch);
+        } else if (cmd[2] >= '0' && cmd[2] <= '2') {
+            ui::set_dual_watch(settings, cmd[2] - '0');
+            settings_changed = true;
+        } else {
+            stdio_puts_raw("?;");
+        }
+#ifdef DSP_PROFILE
+    } else if (strncmp(cmd, "PF", 2) == 0) {
+
+        // Profiler, min, average and max cycles of each stage of the receiver
+        if (cmd[2] == ';') {
+            s_profile_stats profile[num_profile_stages];
+            receiver.refresh_status();
+            for(uint8_t stage = 0; stage < num_profile_stages; ++stage) profile[stage] = status.profile[stage];
+            for(uint8_t stage = 0; stage < num_profile_stages; ++stage) {
+                printf("PF%s,%lu,%lu,%lu;", profile_stage_names[stage], profile[stage].min, profile[stage].avg, profile[stage].max);
+            }
+        } else {
+            stdio_puts_raw("?;");
+        }
+#endif
     } else if (strncmp(cmd, "SM", 2) == 0) {
 
         // Handle mode set/get commands
         if (cmd[3] == ';') {
-            receiver.access(false);
+            receiver.refresh_status();
             float power_dBm = status.signal_strength_dBm;
-            receiver.release();
             float power_scaled = 020*((power_dBm - (-127))/114);
             power_scaled = std::min((float)0x20, power_scaled);
             power_scaled = std::max((float)0, power_scaled);
@@ -184,8 +228,28 @@ void process_cat_control(rx_settings & settings_to_apply, rx_status & status, rx
             printf("PR0;");
         }
     } else if (strncmp(cmd, "NB", 2) == 0) {
+
+        // Noise blanker, 0 = off, 1-3 = low, medium, high
+        if (cmd[2] == ';') {
+            printf("NB%lu;", (settings[idx_rx_features] & mask_noise_blanker) >> flag_noise_blanker);
+        } else if (cmd[2] >= '0' && cmd[2] <= '3') {
+            settings[idx_rx_features] &= ~mask_noise_blanker;
+            settings[idx_rx_features] |= (uint32_t)(cmd[2] - '0') << flag_noise_blanker;
+            settings_changed = true;
+        } else {
+            stdio_puts_raw("?;");
+        }
+    } else if (strncmp(cmd, "AL", 2) == 0) {
+
+        // AGC look-ahead, 0 = off, 1 = on
         if (cmd[2] == ';') {
-            printf("NB0;");
+            printf("AL%lu;", (settings[idx_rx_features] & mask_agc_look_ahead) >> flag_agc_look_ahead);
+        } else if (cmd[2] >= '0' && cmd[2] <= '1') {
+            settings[idx_rx_features] &= ~mask_agc_look_ahead;
+            settings[idx_rx_features] |= (uint32_t)(cmd[2] - '0') << flag_agc_look_ahead;
+            settings_changed = true;
+        } else {
+            stdio_puts_raw("?;");
         }
     } else if (strncmp(cmd, "LK", 2) == 0) {
         if (cmd[2] == ';') {
@@ -216,8 +280,16 @@ void process_cat_control(rx_settings & settings_to_apply, rx_status & status, rx
             printf("ML000;");
         }
     } else if (strncmp(cmd, "NR", 2) == 0) {
+
+        // Noise reduction, 0 = off, 1-3 = low, medium, high
         if (cmd[2] == ';') {
-            printf("NR0;");
+            printf("NR%lu;", (settings[idx_rx_features] & mask_noise_reduction) >> flag_noise_reduction);
+        } else if (cmd[2] >= '0' && cmd[2] <= '3') {
+            settings[idx_rx_features] &= ~mask_noise_reduction;
+            settings[idx_rx_features] |= (uint32_t)(cmd[2] - '0') << flag_noise_reduction;
+            settings_changed = true;
+        } else {
+            stdio_puts_raw("?;");
         }
     } else if (strncmp(cmd, "SD", 2) == 0) {
         if (cmd[2] == ';') {
@@ -293,7 +365,6 @@ void process_cat_control(rx_settings & settings_to_apply, rx_status & status, rx
     //apply settings to receiver
     if(settings_changed)
     {
-      receiver.access(true);
       settings_to_apply.tuned_frequency_Hz = settings[idx_frequency];
       settings_to_apply.agc_speed = settings[idx_agc_speed];
       settings_to_apply.enable_auto_notch = settings[idx_rx_features] >> flag_enable_auto_notch & 1;
@@ -315,7 +386,14 @@ void process_cat_control(rx_settings & settings_to_apply, rx_status & status, rx
       settings_to_apply.band_6_limit = ((settings[idx_band2] >> 8) & 0xff);
       settings_to_apply.band_7_limit = ((settings[idx_band2] >> 16) & 0xff);
       settings_to_apply.ppm = (settings[idx_hw_setup] & mask_ppm) >> flag_ppm;
-      receiver.release();
+      settings_to_apply.noise_reduction = (settings[idx_rx_features] & mask_noise_reduction) >> flag_noise_reduction;
+      settings_to_apply.noise_blanker = (settings[idx_rx_features] & mask_noise_blanker) >> flag_noise_blanker;
+      settings_to_apply.agc_look_ahead = (settings[idx_rx_features] & mask_agc_look_ahead) >> flag_agc_look_ahead;
+      settings_to_apply.dual_watch = (settings[idx_rx_features] & mask_dual_watch) >> flag_dual_watch;
+      settings_to_apply.dual_watch_frequency_Hz = settings[idx_dual_watch_frequency];
+      settings_to_apply.dma_ring_depth = 2 << ((settings[idx_hw_setup] & mask_dma_ring_depth) >> flag_dma_ring_depth);
+      settings_to_apply.load_shedding = (settings[idx_hw_setup] & mask_load_shedding) >> flag_load_shedding;
+      receiver.publish_settings(true);
     }
 
 }
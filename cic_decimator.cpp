@@ -0,0 +1,95 @@
+#include "cic_decimator.h"
+#include "pico/stdlib.h"
+
+//integrator chain update for one input sample
+static inline __attribute__((always_inline)) void integrate(uint32_t &s1, uint32_t &s2, uint32_t &s3, uint32_t &s4, uint32_t x)
+{
+  s1 += x;
+  s2 += s1;
+  s3 += s2;
+  s4 += s3;
+}
+
+//integrator chain update for a zero input sample
+static inline __attribute__((always_inline)) void integrate_zero(uint32_t &s1, uint32_t &s2, uint32_t &s3, uint32_t &s4)
+{
+  s2 += s1;
+  s3 += s2;
+  s4 += s3;
+}
+
+//comb stages, returns the decimated output with the bit growth removed
+static inline __attribute__((always_inline)) int16_t comb(uint32_t s4, uint32_t &d0, uint32_t &d1, uint32_t &d2, uint32_t &d3)
+{
+  const uint32_t comb1 = s4-d0;
+  const uint32_t comb2 = comb1-d1;
+  const uint32_t comb3 = comb2-d2;
+  const uint32_t comb4 = comb3-d3;
+  d0 = s4;
+  d1 = comb1;
+  d2 = comb2;
+  d3 = comb3;
+
+  //remove bit growth, but keep some extra bits since noise floor is now lower
+  return (int32_t)comb4>>(cic_bit_growth-extra_bits);
+}
+
+cic_decimator :: cic_decimator()
+{
+  for(uint8_t stage=0; stage<cic_order; ++stage)
+  {
+    integrator_i[stage] = 0;
+    integrator_q[stage] = 0;
+    delay_i[stage] = 0;
+    delay_q[stage] = 0;
+  }
+}
+
+void __not_in_flash_func(cic_decimator :: process_block)(const uint16_t samples[], int16_t real[], int16_t imag[], bool swap_iq)
+{
+  //The "lead" chain takes the even samples, and the "trail" chain the odd
+  //samples. Normally even samples are I, swapping just exchanges the chains
+  //so there is no need to test swap_iq in the loop.
+  uint32_t *lead_integrator = swap_iq?integrator_q:integrator_i;
+  uint32_t *trail_integrator = swap_iq?integrator_i:integrator_q;
+  uint32_t *lead_delay = swap_iq?delay_q:delay_i;
+  uint32_t *trail_delay = swap_iq?delay_i:delay_q;
+  int16_t *lead_out = swap_iq?imag:real;
+  int16_t *trail_out = swap_iq?real:imag;
+
+  //work on local copies so that the state stays in registers
+  uint32_t l1 = lead_integrator[0], l2 = lead_integrator[1], l3 = lead_integrator[2], l4 = lead_integrator[3];
+  uint32_t t1 = trail_integrator[0], t2 = trail_integrator[1], t3 = trail_integrator[2], t4 = trail_integrator[3];
+  uint32_t ld0 = lead_delay[0], ld1 = lead_delay[1], ld2 = lead_delay[2], ld3 = lead_delay[3];
+  uint32_t td0 = trail_delay[0], td1 = trail_delay[1], td2 = trail_delay[2], td3 = trail_delay[3];
+
+  uint16_t odx = 0;
+  for(uint16_t idx=0; idx<adc_block_size; idx+=cic_decimation_rate)
+  {
+    //integrators, unrolled over the samples making up one output
+    #pragma GCC unroll 8
+    for(uint16_t sub=0; sub<cic_decimation_rate; sub+=2)
+    {
+      const uint32_t even = samples[idx+sub];
+      const uint32_t odd = samples[idx+sub+1];
+
+      //even sample, odd channel sees a zero
+      integrate(l1, l2, l3, l4, even);
+      integrate_zero(t1, t2, t3, t4);
+
+      //odd sample, even channel sees a zero
+      integrate_zero(l1, l2, l3, l4);
+      integrate(t1, t2, t3, t4, odd);
+    }
+
+    //combs, once per output sample
+    lead_out[odx] = comb(l4, ld0, ld1, ld2, ld3);
+    trail_out[odx] = comb(t4, td0, td1, td2, td3);
+    ++odx;
+  }
+
+  lead_integrator[0] = l1; lead_integrator[1] = l2; lead_integrator[2] = l3; lead_integrator[3] = l4;
+  trail_integrator[0] = t1; trail_integrator[1] = t2; trail_integrator[2] = t3; trail_integrator[3] = t4;
+  lead_delay[0] = ld0; lead_delay[1] = ld1; lead_delay[2] = ld2; lead_delay[3] = ld3;
+  trail_delay[0] = td0; trail_delay[1] = td1; trail_delay[2] = td2; trail_delay[3] = td3;
+}
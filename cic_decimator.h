@@ -0,0 +1,30 @@
+#ifndef CIC_DECIMATOR_H
+#define CIC_DECIMATOR_H
+
+#include <stdint.h>
+#include "rx_definitions.h"
+
+//4th order CIC decimator
+//
+//Works on a whole block of raw ADC samples at a time. Even samples hold I
+//(or Q when swapped) and odd samples hold Q, so the input is deinterleaved
+//into two integrator chains as it is read. Each chain sees its sample
+//followed by a zero, exactly as if the interleaved stream had been split by
+//multiplying by 0 or 1, so the output is bit-exact with a per-sample
+//implementation.
+class cic_decimator
+{
+  //unsigned so that wraparound in the integrators is well defined
+  uint32_t integrator_i[cic_order];
+  uint32_t integrator_q[cic_order];
+  uint32_t delay_i[cic_order];
+  uint32_t delay_q[cic_order];
+
+  public:
+  cic_decimator();
+  //decimate adc_block_size interleaved samples into
+  //adc_block_size/cic_decimation_rate I and Q samples
+  void process_block(const uint16_t samples[], int16_t real[], int16_t imag[], bool swap_iq);
+};
+
+#endif
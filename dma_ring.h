@@ -0,0 +1,131 @@
+#ifndef DMA_RING_H
+#define DMA_RING_H
+
+#include <stdint.h>
+#include "rx_definitions.h"
+
+//Sequencing of the ADC and PWM DMA ring
+//
+//Each direction has a data channel, and a control channel that re-arms it
+//from a list of slot addresses, so that the ring runs without the CPU:
+//
+//  adc data --chain--> adc control --chain--> pwm control
+//     ^                    |                      |
+//     +-- WRITE_ADDR_TRIG -+     pwm data <-------+ READ_ADDR_TRIG
+//
+//A channel reloads its transfer count each time it is triggered, so the
+//control channels only need to write one address per block. The lists wrap
+//using the DMA read ring, so they are aligned to their size and the depth is
+//a power of two.
+//
+//Starting the adc control channel starts adc block 0 and plays audio slot 0.
+//After that, when adc block n completes, adc block n+1 starts and audio slot
+//(n+1)%depth, which holds the audio from block n+1-depth, plays. The pwm is
+//restarted with every adc block, so the two clocks can't drift apart.
+//
+//  e.g. a ring of 4 blocks
+//  adc        | 0 | 1 | 2 | 3 | 4 | 5 |
+//  processing     | 0 |   | 1 | 2 |3|
+//  pwm        |   |   |   |   | 0 | 1 |
+//
+//Processing of block n can start once it completes, and must finish before
+//block n+depth starts, so it can fall up to depth-2 blocks behind without a
+//gap in the audio. The only interrupt counts completed adc blocks.
+
+static_assert((max_dma_ring_depth & (max_dma_ring_depth - 1)) == 0, "DMA_RING_DEPTH must be a power of 2");
+
+//slot addresses read by a control channel, aligned for the read ring
+struct alignas(max_dma_ring_depth * sizeof(uintptr_t)) s_dma_control_list
+{
+  uintptr_t address[max_dma_ring_depth];
+};
+
+class dma_ring
+{
+  uint8_t depth;
+  uint32_t blocks_processed;
+  uint32_t overruns;
+  uint32_t underruns;
+
+  public:
+  dma_ring() : depth(2), blocks_processed(0), overruns(0), underruns(0) {}
+
+  //largest power of 2 from 2 to max_dma_ring_depth, no more than requested
+  static uint8_t valid_depth(uint8_t requested)
+  {
+    uint8_t valid = 2;
+    while(valid < max_dma_ring_depth && (valid << 1) <= requested) valid <<= 1;
+    return valid;
+  }
+
+  //call before (re)starting the dma, overrun and underrun counts are kept
+  void start(uint8_t requested_depth)
+  {
+    depth = valid_depth(requested_depth);
+    blocks_processed = 0;
+  }
+
+  uint8_t get_depth() const { return depth; }
+  uint8_t slot(uint32_t block) const { return block & (depth - 1); }
+
+  //size of a control list in bytes, as a power of 2 for the read ring
+  uint8_t control_ring_bits() const
+  {
+    uint8_t bits = 0;
+    while((1u << bits) < depth * sizeof(uintptr_t)) ++bits;
+    return bits;
+  }
+
+  //point the control list at each slot of a buffer in turn
+  void fill_control_list(s_dma_control_list &list, const void *buffer, uint32_t slot_bytes) const
+  {
+    for(uint8_t i = 0; i < depth; ++i)
+    {
+      list.address[i] = (uintptr_t)buffer + i * slot_bytes;
+    }
+  }
+
+  //true when there is a completed block to process
+  bool block_ready(uint32_t blocks_written) const
+  {
+    return blocks_written != blocks_processed;
+  }
+
+  //the next block to process. If the DSP has fallen a whole ring behind,
+  //the oldest blocks are being overwritten, so skip to the newest.
+  uint32_t next_block(uint32_t blocks_written)
+  {
+    if(blocks_written - blocks_processed >= depth)
+    {
+      overruns += blocks_written - 1 - blocks_processed;
+      blocks_processed = blocks_written - 1;
+    }
+    return blocks_processed;
+  }
+
+  //call once the audio for the block from next_block has been written. If
+  //its slot has already started playing, the stale audio is counted.
+  void block_done(uint32_t blocks_written)
+  {
+    audio_done(blocks_processed, blocks_written);
+    blocks_processed++;
+  }
+
+  //When the processing is split across the cores, the first stage moves on
+  //from a block once it has handed it over, and the last stage reports when
+  //the audio for the block has been written.
+  void block_handed_off()
+  {
+    blocks_processed++;
+  }
+
+  void audio_done(uint32_t block, uint32_t blocks_written)
+  {
+    if(blocks_written - block >= depth) underruns++;
+  }
+
+  uint32_t get_overruns() const { return overruns; }
+  uint32_t get_underruns() const { return underruns; }
+};
+
+#endif
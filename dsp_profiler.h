@@ -0,0 +1,170 @@
+#ifndef DSP_PROFILER_H
+#define DSP_PROFILER_H
+
+#include <stdint.h>
+
+//Per stage timing of the receive chain
+//
+//Only built when DSP_PROFILE is defined (cmake -DPICORX_PROFILE=ON),
+//otherwise the PROFILE_ macros expand to nothing. Each stage is timed from
+//the end of the one before, so each block costs one counter read per stage.
+//Minimum, average and maximum are kept over a window of profile_window
+//blocks, and the results of the last complete window can be read at any time.
+//
+//The firmware counts processor clock cycles using SysTick, which is 24 bits
+//wide, so no stage may take longer than 2^24 cycles. On the host the counts
+//are in ns.
+
+enum e_profile_stage
+{
+  profile_noise_blanker,
+  profile_cic,
+  profile_front_end,    //dc removal, iq correction and frequency shift
+  profile_fft_filter,
+  profile_demodulate,   //demodulator, de-emphasis, agc and squelch
+  profile_dual_watch,
+  profile_post_process, //volume, pwm and usb audio in rx::process_block
+  profile_block,        //the whole block
+  num_profile_stages
+};
+
+struct s_profile_stats
+{
+  uint32_t min;
+  uint32_t avg;
+  uint32_t max;
+};
+
+#ifdef DSP_PROFILE
+
+//short names, for the status page and the PF cat command
+static const char * const profile_stage_names[num_profile_stages] =
+{
+  "NB", "CIC", "Front", "FFT", "Demod", "Watch", "Post", "Block"
+};
+
+#ifdef SIMULATION
+#include <chrono>
+#else
+#include "hardware/structs/systick.h"
+#endif
+
+class dsp_profiler
+{
+  static const uint8_t profile_window_bits = 6;
+  static const uint16_t profile_window = 1u << profile_window_bits;
+
+  uint32_t block_start;
+  uint32_t last_mark;
+  uint16_t count;
+  uint32_t min[num_profile_stages];
+  uint32_t max[num_profile_stages];
+  uint32_t sum[num_profile_stages];
+  s_profile_stats stats[num_profile_stages];
+
+  static inline uint32_t now()
+  {
+#ifdef SIMULATION
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#else
+    //SysTick counts down, negate so that time goes up
+    return -systick_hw->cvr;
+#endif
+  }
+
+  static inline uint32_t elapsed(uint32_t from, uint32_t to)
+  {
+#ifdef SIMULATION
+    return to - from;
+#else
+    return (to - from) & 0xffffffu;
+#endif
+  }
+
+  void reset_window()
+  {
+    count = 0;
+    for(uint8_t stage = 0; stage < num_profile_stages; ++stage)
+    {
+      min[stage] = UINT32_MAX;
+      max[stage] = 0;
+      sum[stage] = 0;
+    }
+  }
+
+  void record(uint8_t stage, uint32_t time)
+  {
+    if(time < min[stage]) min[stage] = time;
+    if(time > max[stage]) max[stage] = time;
+    sum[stage] += time;
+  }
+
+  public:
+  dsp_profiler() : block_start(0), last_mark(0)
+  {
+    reset_window();
+    for(uint8_t stage = 0; stage < num_profile_stages; ++stage)
+    {
+      stats[stage] = {0, 0, 0};
+    }
+  }
+
+  void start_block()
+  {
+#ifndef SIMULATION
+    //SysTick belongs to the core, so start it on the one doing the processing
+    if(!(systick_hw->csr & 1u))
+    {
+      systick_hw->rvr = 0xffffffu;
+      systick_hw->cvr = 0;
+      systick_hw->csr = 0x5u; //enabled, processor clock, no interrupt
+    }
+#endif
+    block_start = last_mark = now();
+  }
+
+  //time since the last mark (or the start of the block) is spent in stage
+  void mark(e_profile_stage stage)
+  {
+    const uint32_t time = now();
+    record(stage, elapsed(last_mark, time));
+    last_mark = time;
+  }
+
+  void end_block()
+  {
+    record(profile_block, elapsed(block_start, now()));
+    if(++count < profile_window) return;
+
+    //stages that were never timed (e.g. post processing on the host) read 0
+    for(uint8_t stage = 0; stage < num_profile_stages; ++stage)
+    {
+      stats[stage].min = min[stage] == UINT32_MAX ? 0 : min[stage];
+      stats[stage].avg = sum[stage] >> profile_window_bits;
+      stats[stage].max = max[stage];
+    }
+    reset_window();
+  }
+
+  void get_stats(s_profile_stats result[]) const
+  {
+    for(uint8_t stage = 0; stage < num_profile_stages; ++stage)
+    {
+      result[stage] = stats[stage];
+    }
+  }
+};
+
+#define PROFILE_START(profiler) (profiler).start_block()
+#define PROFILE_MARK(profiler, stage) (profiler).mark(stage)
+#define PROFILE_END(profiler) (profiler).end_block()
+
+#else
+
+#define PROFILE_START(profiler)
+#define PROFILE_MARK(profiler, stage)
+#define PROFILE_END(profiler)
+
+#endif
+
+#endif
@@ -1,4 +1,5 @@
 #include "fft.h"
+#include "rx_definitions.h"
 #include <cmath>
 #include <cstdint>
 #include <cstdio>
@@ -7,11 +8,7 @@
 #include "pico/stdlib.h"
 #endif
 
-static const uint16_t max_m = 8; // the largest size of FFT supported
-static const uint16_t max_n_over_2 = 1 << (max_m - 1);
-static int16_t fixed_cos_table[max_n_over_2];
-static int16_t fixed_sin_table[max_n_over_2];
-static const uint8_t fraction_bits = 14;
+static const uint8_t fraction_bits = fft_fraction_bits;
 static const int16_t K  =  (1 << (fraction_bits - 1));
 
 int16_t float2fixed(float float_value) {
@@ -21,118 +18,191 @@ int16_t product(int16_t a, int16_t b) {
         return ((static_cast<int32_t>(b) * a)+K) >> fraction_bits;
 }
 
-void fft_initialise() {
-  for (int i = 0; i < max_n_over_2; ++i) {
-    fixed_cos_table[i] = float2fixed(cosf((float)i * M_PI / max_n_over_2));
-    fixed_sin_table[i] = float2fixed(sinf((float)i * M_PI / max_n_over_2));
+//Radix-4 decimation in time. Each pass combines four sub-dfts of q points
+//into one of 4q points, so the twiddle factors needed by each pass are
+//stored separately, in the order they are used. When m is odd, a single
+//radix-2 stage comes first. Everything is generated at compile time.
+struct s_fft_twiddle
+{
+  int16_t cos1, sin1; //W^j
+  int16_t cos2, sin2; //W^2j
+  int16_t cos3, sin3; //W^3j
+};
+
+template <unsigned m>
+struct s_fft_plan
+{
+  static const uint16_t n = 1u << m;
+  static const uint16_t first_q = (m & 1) ? 2 : 1;
+
+  //pairs of samples exchanged by the bit reverse permutation
+  static const uint16_t num_swaps = (n - (1u << ((m + 1)/2)))/2;
+  uint16_t swaps[num_swaps][2];
+
+  static constexpr uint16_t count_twiddles()
+  {
+    uint16_t count = 0;
+    for(uint16_t q = first_q; q < n; q *= 4) count += q;
+    return count;
   }
-}
+  static const uint16_t num_twiddles = count_twiddles();
+  s_fft_twiddle twiddles[num_twiddles];
 
-#ifndef SIMULATION
-unsigned __not_in_flash_func(bit_reverse)(unsigned x, unsigned m) {
-#else
-unsigned bit_reverse(unsigned x, unsigned m) {
-#endif
-    static const unsigned char lookup[] = {
-        0x00, 0x80, 0x40, 0xc0, 0x20, 0xa0, 0x60, 0xe0,
-        0x10, 0x90, 0x50, 0xd0, 0x30, 0xb0, 0x70, 0xf0,
-        0x08, 0x88, 0x48, 0xc8, 0x28, 0xa8, 0x68, 0xe8,
-        0x18, 0x98, 0x58, 0xd8, 0x38, 0xb8, 0x78, 0xf8,
-        0x04, 0x84, 0x44, 0xc4, 0x24, 0xa4, 0x64, 0xe4,
-        0x14, 0x94, 0x54, 0xd4, 0x34, 0xb4, 0x74, 0xf4,
-        0x0c, 0x8c, 0x4c, 0xcc, 0x2c, 0xac, 0x6c, 0xec,
-        0x1c, 0x9c, 0x5c, 0xdc, 0x3c, 0xbc, 0x7c, 0xfc,
-        0x02, 0x82, 0x42, 0xc2, 0x22, 0xa2, 0x62, 0xe2,
-        0x12, 0x92, 0x52, 0xd2, 0x32, 0xb2, 0x72, 0xf2,
-        0x0a, 0x8a, 0x4a, 0xca, 0x2a, 0xaa, 0x6a, 0xea,
-        0x1a, 0x9a, 0x5a, 0xda, 0x3a, 0xba, 0x7a, 0xfa,
-        0x06, 0x86, 0x46, 0xc6, 0x26, 0xa6, 0x66, 0xe6,
-        0x16, 0x96, 0x56, 0xd6, 0x36, 0xb6, 0x76, 0xf6,
-        0x0e, 0x8e, 0x4e, 0xce, 0x2e, 0xae, 0x6e, 0xee,
-        0x1e, 0x9e, 0x5e, 0xde, 0x3e, 0xbe, 0x7e, 0xfe,
-        0x01, 0x81, 0x41, 0xc1, 0x21, 0xa1, 0x61, 0xe1,
-        0x11, 0x91, 0x51, 0xd1, 0x31, 0xb1, 0x71, 0xf1,
-        0x09, 0x89, 0x49, 0xc9, 0x29, 0xa9, 0x69, 0xe9,
-        0x19, 0x99, 0x59, 0xd9, 0x39, 0xb9, 0x79, 0xf9,
-        0x05, 0x85, 0x45, 0xc5, 0x25, 0xa5, 0x65, 0xe5,
-        0x15, 0x95, 0x55, 0xd5, 0x35, 0xb5, 0x75, 0xf5,
-        0x0d, 0x8d, 0x4d, 0xcd, 0x2d, 0xad, 0x6d, 0xed,
-        0x1d, 0x9d, 0x5d, 0xdd, 0x3d, 0xbd, 0x7d, 0xfd,
-        0x03, 0x83, 0x43, 0xc3, 0x23, 0xa3, 0x63, 0xe3,
-        0x13, 0x93, 0x53, 0xd3, 0x33, 0xb3, 0x73, 0xf3,
-        0x0b, 0x8b, 0x4b, 0xcb, 0x2b, 0xab, 0x6b, 0xeb,
-        0x1b, 0x9b, 0x5b, 0xdb, 0x3b, 0xbb, 0x7b, 0xfb,
-        0x07, 0x87, 0x47, 0xc7, 0x27, 0xa7, 0x67, 0xe7,
-        0x17, 0x97, 0x57, 0xd7, 0x37, 0xb7, 0x77, 0xf7,
-        0x0f, 0x8f, 0x4f, 0xcf, 0x2f, 0xaf, 0x6f, 0xef,
-        0x1f, 0x9f, 0x5f, 0xdf, 0x3f, 0xbf, 0x7f, 0xff,
-  };
-  x = (lookup[x&0xff] << 8) | lookup[x>>8];
-  return x >> (16-m);
+  constexpr s_fft_plan() : swaps(), twiddles()
+  {
+    uint16_t swap = 0;
+    for(uint16_t i = 0; i < n; ++i)
+    {
+      uint16_t reversed = 0;
+      for(uint16_t bit = 0; bit < m; ++bit)
+      {
+        if(i & (1u << bit)) reversed |= 1u << (m - bit - 1);
+      }
+      if(i < reversed)
+      {
+        swaps[swap][0] = i;
+        swaps[swap][1] = reversed;
+        swap++;
+      }
+    }
+
+    uint16_t twiddle = 0;
+    for(uint16_t q = first_q; q < n; q *= 4)
+    {
+      for(uint16_t j = 0; j < q; ++j)
+      {
+        const double angle = 2.0 * constexpr_pi * j / (4.0 * q);
+        twiddles[twiddle].cos1 = constexpr_float2fixed(constexpr_cos(angle));
+        twiddles[twiddle].sin1 = constexpr_float2fixed(constexpr_sin(angle));
+        twiddles[twiddle].cos2 = constexpr_float2fixed(constexpr_cos(2.0 * angle));
+        twiddles[twiddle].sin2 = constexpr_float2fixed(constexpr_sin(2.0 * angle));
+        twiddles[twiddle].cos3 = constexpr_float2fixed(constexpr_cos(3.0 * angle));
+        twiddles[twiddle].sin3 = constexpr_float2fixed(constexpr_sin(3.0 * angle));
+        twiddle++;
+      }
+    }
+  }
+};
+
+//not const, so that the tables are placed in RAM
+template <unsigned m>
+static s_fft_plan<m> fft_plan;
+
+//multiply by cos - j sin, rounding once
+static inline __attribute__((always_inline)) void rotate(int32_t &real, int32_t &imaginary, int32_t cos, int32_t sin)
+{
+  const int32_t rotated_real = (real * cos + imaginary * sin + K) >> fraction_bits;
+  const int32_t rotated_imaginary = (imaginary * cos - real * sin + K) >> fraction_bits;
+  real = rotated_real;
+  imaginary = rotated_imaginary;
 }
 
-#ifndef SIMULATION
-void __not_in_flash_func(fixed_fft)(int16_t reals[], int16_t imaginaries[], unsigned m, bool scale) {
-#else
-void fixed_fft(int16_t reals[], int16_t imaginaries[], unsigned m, bool scale) {
-#endif
-  uint16_t stage, subdft_size, span, j, i, ip;
-  int16_t temp_real, temp_imaginary;
-  int16_t imaginary_twiddle, real_twiddle;
-  const unsigned n = 1 << m;
+//In bit reversed order, the sub-dfts of the even-even, even-odd, odd-even
+//and odd-odd samples sit at i, i+2q, i+q and i+3q. The intermediate results
+//are kept at full precision, and scaled (with rounding) once per pass.
+template <bool twiddle>
+static inline __attribute__((always_inline)) void butterfly4(int16_t reals[], int16_t imaginaries[], uint16_t i, uint16_t q, const s_fft_twiddle &w, uint8_t shift)
+{
+  //adding the rounding to a rounds all four outputs
+  const int32_t round = (1 << shift) >> 1;
+  int32_t ar = reals[i] + round,     ai = imaginaries[i] + round;
+  int32_t cr = reals[i + q],         ci = imaginaries[i + q];
+  int32_t br = reals[i + 2*q],       bi = imaginaries[i + 2*q];
+  int32_t dr = reals[i + 3*q],       di = imaginaries[i + 3*q];
 
-  // bit reverse data
-  for (i = 0u; i < n; i++) {
-    ip = bit_reverse(i, m);
-    if (i < ip) {
-      temp_real = reals[i];
-      temp_imaginary = imaginaries[i];
-      reals[i] = reals[ip];
-      imaginaries[i] = imaginaries[ip];
-      reals[ip] = temp_real;
-      imaginaries[ip] = temp_imaginary;
-    }
+  if(twiddle)
+  {
+    rotate(br, bi, w.cos1, w.sin1);
+    rotate(cr, ci, w.cos2, w.sin2);
+    rotate(dr, di, w.cos3, w.sin3);
   }
 
-  // butterfly multiplies
-  for (stage = 0; stage < m; stage++) {
-    subdft_size = 2 << stage;
-    span = subdft_size >> 1;
+  const int32_t t0r = ar + cr, t0i = ai + ci;
+  const int32_t t1r = ar - cr, t1i = ai - ci;
+  const int32_t t2r = br + dr, t2i = bi + di;
+  const int32_t t3r = br - dr, t3i = bi - di;
 
-    for (j = 0; j < span; j++) {
-      for (i = j; i < n; i += subdft_size) {
-        ip = i + span;
+  reals[i]             = (t0r + t2r) >> shift;
+  imaginaries[i]       = (t0i + t2i) >> shift;
+  reals[i + q]         = (t1r + t3i) >> shift;
+  imaginaries[i + q]   = (t1i - t3r) >> shift;
+  reals[i + 2*q]       = (t0r - t2r) >> shift;
+  imaginaries[i + 2*q] = (t0i - t2i) >> shift;
+  reals[i + 3*q]       = (t1r - t3i) >> shift;
+  imaginaries[i + 3*q] = (t1i + t3r) >> shift;
+}
+
+template <unsigned m>
+void fixed_fft(int16_t reals[], int16_t imaginaries[], bool scale) {
+  typedef s_fft_plan<m> plan;
+  const unsigned n = plan::n;
+  const uint8_t shift = scale ? 1 : 0;
 
-        real_twiddle = fixed_cos_table[j << (max_m - stage - 1)];
-        imaginary_twiddle = -fixed_sin_table[j << (max_m - stage - 1)];
+  // bit reverse data
+  for (uint16_t i = 0u; i < plan::num_swaps; i++) {
+    const uint16_t a = fft_plan<m>.swaps[i][0];
+    const uint16_t b = fft_plan<m>.swaps[i][1];
+    const int16_t temp_real = reals[a];
+    const int16_t temp_imaginary = imaginaries[a];
+    reals[a] = reals[b];
+    imaginaries[a] = imaginaries[b];
+    reals[b] = temp_real;
+    imaginaries[b] = temp_imaginary;
+  }
 
-        temp_real = product(reals[ip], real_twiddle) -
-                    product(imaginaries[ip], imaginary_twiddle);
-        temp_imaginary = product(reals[ip], imaginary_twiddle) +
-                         product(imaginaries[ip], real_twiddle);
+  // for odd m, a radix-2 stage without twiddles or scaling
+  if (m & 1) {
+    for (uint16_t i = 0u; i < n; i += 2) {
+      const int16_t temp_real = reals[i + 1];
+      const int16_t temp_imaginary = imaginaries[i + 1];
+      reals[i + 1] = reals[i] - temp_real;
+      imaginaries[i + 1] = imaginaries[i] - temp_imaginary;
+      reals[i] = reals[i] + temp_real;
+      imaginaries[i] = imaginaries[i] + temp_imaginary;
+    }
+  }
 
-        reals[ip] = reals[i] - temp_real;
-        imaginaries[ip] = imaginaries[i] - temp_imaginary;
+  // radix-4 passes, losing 1 bit in each
+  const s_fft_twiddle *twiddles = fft_plan<m>.twiddles;
+  for (uint16_t q = plan::first_q; q < n; q *= 4) {
+    const uint16_t subdft_size = 4 * q;
 
-        reals[i] = reals[i] + temp_real;
-        imaginaries[i] = imaginaries[i] + temp_imaginary;
+    //the first butterfly of each sub-dft has no twiddles
+    for (uint16_t i = 0; i < n; i += subdft_size) {
+      butterfly4<false>(reals, imaginaries, i, q, twiddles[0], shift);
+    }
 
-        // after every second stage lose 1 bit
-        if (stage & 1) {
-          reals[ip] = reals[ip]/2;
-          imaginaries[ip] = imaginaries[ip]/2;
-          reals[i] = reals[i]/2;
-          imaginaries[i] = imaginaries[i]/2;
-        }
+    for (uint16_t j = 1; j < q; j++) {
+      const s_fft_twiddle w = twiddles[j];
+      for (uint16_t i = j; i < n; i += subdft_size) {
+        butterfly4<true>(reals, imaginaries, i, q, w, shift);
       }
     }
+
+    twiddles += q;
   }
 }
 
-#ifndef SIMULATION
-void __not_in_flash_func(fixed_ifft)(int16_t reals[], int16_t imaginaries[], unsigned m) {
+template <unsigned m>
+void fixed_ifft(int16_t reals[], int16_t imaginaries[]) {
+  fixed_fft<m>(imaginaries, reals, true);
+}
+
+//The fft filter needs a forward fft of 2^FFT_ORDER points and an inverse
+//fft of half that size. The host build instantiates every supported size
+//so that they can all be tested. GCC ignores section attributes on
+//implicitly instantiated templates, so RAM placement goes here.
+#ifdef SIMULATION
+template void fixed_fft<7>(int16_t reals[], int16_t imaginaries[], bool scale);
+template void fixed_fft<8>(int16_t reals[], int16_t imaginaries[], bool scale);
+template void fixed_fft<9>(int16_t reals[], int16_t imaginaries[], bool scale);
+template void fixed_fft<10>(int16_t reals[], int16_t imaginaries[], bool scale);
+template void fixed_ifft<7>(int16_t reals[], int16_t imaginaries[]);
+template void fixed_ifft<8>(int16_t reals[], int16_t imaginaries[]);
+template void fixed_ifft<9>(int16_t reals[], int16_t imaginaries[]);
 #else
-void fixed_ifft(int16_t reals[], int16_t imaginaries[], unsigned m) {
+template void __not_in_flash_func(fixed_fft<FFT_ORDER>)(int16_t reals[], int16_t imaginaries[], bool scale);
+//the inverse fft is a wrapper, its kernel needs placing too
+template void __not_in_flash_func(fixed_fft<FFT_ORDER-1>)(int16_t reals[], int16_t imaginaries[], bool scale);
+template void __not_in_flash_func(fixed_ifft<FFT_ORDER-1>)(int16_t reals[], int16_t imaginaries[]);
 #endif
-  fixed_fft(imaginaries, reals, m, true);
-}
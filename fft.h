@@ -2,9 +2,42 @@
 #define FFT_H_
 #include <cstdint>
 
-void fft_initialise();
-void fixed_fft(int16_t reals[], int16_t imaginaries[], unsigned m, bool scale=true);
-void fixed_ifft(int16_t reals[], int16_t imaginaries[], unsigned m);
+static const uint8_t fft_fraction_bits = 14;
+
+//compile time sin/cos for generating lookup tables
+//argument is reduced to -pi..pi, then a Taylor series is plenty accurate
+//for 14 bit fixed point
+constexpr double constexpr_pi = 3.14159265358979323846;
+
+constexpr double constexpr_sin(double x)
+{
+  while(x > constexpr_pi) x -= 2.0*constexpr_pi;
+  while(x < -constexpr_pi) x += 2.0*constexpr_pi;
+  double term = x;
+  double sum = x;
+  for(int n = 1; n < 20; ++n)
+  {
+    term *= -x*x/((2*n)*(2*n+1));
+    sum += term;
+  }
+  return sum;
+}
+
+constexpr double constexpr_cos(double x)
+{
+  return constexpr_sin(x + constexpr_pi/2.0);
+}
+
+constexpr int16_t constexpr_float2fixed(double x)
+{
+  return (int16_t)(x * (1 << fft_fraction_bits) + (x < 0.0 ? -0.5 : 0.5));
+}
+
+//in place fft of 2^m points, the output is scaled by 2^-floor(m/2)
+template <unsigned m>
+void fixed_fft(int16_t reals[], int16_t imaginaries[], bool scale=true);
+template <unsigned m>
+void fixed_ifft(int16_t reals[], int16_t imaginaries[]);
 int16_t float2fixed(float float_value);
 int16_t product(int16_t a, int16_t b);
 
@@ -15,6 +15,7 @@
 #include "fft.h"
 #include "utils.h"
 #include "cic_corrections.h"
+#include "rx_definitions.h"
 #include <cmath>
 #include <cstdio>
 #include <algorithm>
@@ -23,154 +24,297 @@
 #include "pico/stdlib.h"
 #endif
 
-static int16_t cic_correct(int16_t fft_bin, int16_t fft_offset, int16_t sample)
+static inline __attribute__((always_inline)) int16_t apply_gain(int16_t sample, uint16_t gain)
 {
-  int16_t corrected_fft_bin = (fft_bin + fft_offset);
-  if(corrected_fft_bin > 127) corrected_fft_bin -= 256;
-  if(corrected_fft_bin < -128) corrected_fft_bin += 256;
-  uint16_t unsigned_fft_bin = abs(corrected_fft_bin); 
-  int32_t adjusted_sample = ((int32_t)sample * cic_correction[unsigned_fft_bin]) >> 8;
+  const int32_t adjusted_sample = ((int32_t)sample * gain) >> 8;
   return std::max(std::min(adjusted_sample, (int32_t)INT16_MAX), (int32_t)INT16_MIN);
 }
 
-#ifndef SIMULATION
-void __not_in_flash_func(fft_filter::filter_block)(int16_t sample_real[], int16_t sample_imag[], s_filter_control &filter_control, int16_t capture[]) {
-#else
-void fft_filter::filter_block(int16_t sample_real[], int16_t sample_imag[], s_filter_control &filter_control, int16_t capture[]) {
-#endif
+//Bins 0 to new_fft_size/2 are DC and the positive frequencies of the upper
+//sideband, the rest are the negative frequencies of the lower sideband in
+//order of increasing frequency.
+template <uint8_t order>
+const uint16_t *fft_filter<order>::update_gains(s_bin_gains &gains, const s_filter_control &filter_control)
+{
+  const s_filter_control &last = gains.passband;
+  if(gains.valid && last.start_bin == filter_control.start_bin && last.stop_bin == filter_control.stop_bin &&
+     last.fft_bin == filter_control.fft_bin && last.upper_sideband == filter_control.upper_sideband &&
+     last.lower_sideband == filter_control.lower_sideband)
+  {
+    return gains.gain;
+  }
 
-  // window
-  for (uint16_t i = 0; i < fft_size; i++) {
-    sample_real[i] = product(sample_real[i], window[i]);
-    sample_imag[i] = product(sample_imag[i], window[i]);
+  for (uint16_t idx = 0; idx < new_fft_size; idx++) {
+    const bool upper = idx <= new_fft_size/2u;
+    const uint16_t bin = upper ? idx : new_fft_size - idx;
+    const bool sideband = upper ? filter_control.upper_sideband : filter_control.lower_sideband;
+    if(!sideband || bin < filter_control.start_bin || bin > filter_control.stop_bin)
+    {
+      gains.gain[idx] = 0;
+      continue;
+    }
+
+    //correction table is for a 256 point fft
+    int16_t corrected_fft_bin = bin + filter_control.fft_bin;
+    if(corrected_fft_bin > fft_size/2 - 1) corrected_fft_bin -= fft_size;
+    if(corrected_fft_bin < -fft_size/2) corrected_fft_bin += fft_size;
+    gains.gain[idx] = cic_correction[abs(corrected_fft_bin) >> (order - 8)];
   }
+  gains.passband = filter_control;
+  gains.valid = true;
+  return gains.gain;
+}
 
-  // forward FFT
-  fixed_fft(sample_real, sample_imag, 8);
+//Spectral subtraction noise reduction. The noise floor of each bin falls
+//quickly to the bin magnitude, but can only rise by about 1/128 per frame
+//(a few dB per second), so that it follows the noise between signals without
+//being pulled up by them. Each bin is scaled by 1 - k*floor/magnitude,
+//limited to a minimum gain and averaged with the last frame to reduce
+//musical noise.
+template <uint8_t order>
+inline __attribute__((always_inline)) void fft_filter<order>::reduce_noise(uint16_t idx, uint16_t magnitude, uint16_t over_subtraction, uint16_t minimum_gain)
+{
+  const uint32_t level = (uint32_t)magnitude << 8;
+  uint32_t floor = noise_floor[idx];
+  if(level < floor) floor -= (floor - level) >> 2;
+  else floor += std::min((level - floor) >> 4, (floor >> 7) + 16u);
+  noise_floor[idx] = floor;
 
-  if(filter_control.capture)
+  //floor/magnitude uses the reciprocal of the normalised magnitude, as the
+  //agc does, rather than a divide. Only ratios below 256 change the gain,
+  //and for those the product fits in 32 bits.
+  uint16_t gain = minimum_gain;
+  const uint32_t numerator = (over_subtraction * floor) >> 4;
+  if(magnitude && numerator < ((uint32_t)magnitude << 8))
   {
-    for (uint16_t i = 0; i < fft_size; i++) {
-      capture[i] = (((int32_t)capture[i]<<3) - capture[i] + rectangular_2_magnitude(sample_real[i], sample_imag[i])) >> 3;
-    }
+    const uint8_t msb = 31 - __builtin_clz(magnitude);
+    const uint8_t shift = msb > 7 ? msb - 7 : 0;
+    const uint32_t mantissa = msb >= 7 ? magnitude >> (msb - 7) : magnitude << (7 - msb);
+    const uint32_t ratio = ((numerator >> shift) * reciprocal_table.value[mantissa - 128u]) >> (msb + 15 - shift);
+    if(ratio < 256u - minimum_gain) gain = 256u - ratio;
   }
+  gain = (noise_gain[idx] + gain + 1u) >> 1;
+  noise_gain[idx] = gain;
 
-  //largest bin
-  int16_t peak = 0;
-  int16_t next_peak = 0;
-  uint16_t peak_bin = 0;
+  output_real[idx] = ((int32_t)output_real[idx] * gain) >> 8;
+  output_imag[idx] = ((int32_t)output_imag[idx] * gain) >> 8;
+}
 
-  //DC and positive frequencies
-  for (uint16_t i = 0; i < (new_fft_size/2u) + 1; i++) {
-    //clear bins outside pass band
-    if(!filter_control.upper_sideband || i < filter_control.start_bin || i > filter_control.stop_bin)
-    {
-      sample_real[i] = 0;
-      sample_imag[i] = 0;
-    }
-    else
-    {
-      sample_real[i] = cic_correct(i, filter_control.fft_bin, sample_real[i]);
-      sample_imag[i] = cic_correct(i, filter_control.fft_bin, sample_imag[i]);
+//Each notch follows one carrier. Peaks that match a notch (give or take a
+//bin, to allow for drift) increase its count, and the count of unmatched
+//notches decreases. Unmatched peaks take over notches whose count has
+//reached zero. A carrier is notched (along with the bins either side) once
+//it has been present for about half a second, so speech is left alone.
+//Carriers close to DC are never notched, so AM carriers are left alone.
+template <uint8_t order>
+void fft_filter<order>::auto_notch(const s_peak_finder &peaks)
+{
+  //count frames at the same rate whatever the fft size
+  const uint8_t confirm_threshold = 255u >> (order - 8);
+  const uint16_t dc_guard = 3u << (order - 8);
 
-      //capture highest and second highest peak
-      uint16_t magnitude = rectangular_2_magnitude(sample_real[i], sample_imag[i]);
-      if(magnitude > peak)
-      {
-        peak = magnitude; 
-        peak_bin = i;
-      }
-      else if(magnitude > next_peak)
+  bool peak_used[s_peak_finder::max_peaks] = {false};
+  for(uint8_t notch = 0; notch < max_notches; ++notch)
+  {
+    if(!notch_count[notch]) continue;
+    bool found = false;
+    for(uint8_t peak = 0; peak < s_peak_finder::max_peaks; ++peak)
+    {
+      if(peak_used[peak] || !peaks.magnitude[peak]) continue;
+      if(abs((int16_t)peaks.bin[peak] - (int16_t)notch_bin[notch]) <= 1)
       {
-        next_peak = magnitude;
+        notch_bin[notch] = peaks.bin[peak];
+        peak_used[peak] = true;
+        found = true;
+        break;
       }
-
     }
+    if(found && notch_count[notch] < confirm_threshold) notch_count[notch]++;
+    if(!found) notch_count[notch]--;
   }
 
-  //negative frequencies
-  for (uint16_t i = 0; i < (new_fft_size/2u)-1; i++) {
-    const uint16_t bin = new_fft_size/2 - i - 1;
-    const uint16_t new_idx = (new_fft_size/2u) + 1 + i;
-    if(!filter_control.lower_sideband || bin < filter_control.start_bin || bin > filter_control.stop_bin)
+  //start following new peaks, largest first
+  for(uint8_t peak = 0; peak < s_peak_finder::max_peaks; ++peak)
+  {
+    if(peak_used[peak] || !peaks.magnitude[peak]) continue;
+    for(uint8_t notch = 0; notch < max_notches; ++notch)
     {
-      sample_real[new_idx] = 0;
-      sample_imag[new_idx] = 0;
+      if(notch_count[notch]) continue;
+      notch_bin[notch] = peaks.bin[peak];
+      notch_count[notch] = 1;
+      break;
     }
-    else
+  }
+
+  //remove confirmed carriers
+  for(uint8_t notch = 0; notch < max_notches; ++notch)
+  {
+    const uint16_t bin = notch_bin[notch];
+    if((notch_count[notch] > confirm_threshold/2u) && (bin > dc_guard) && (bin < new_fft_size - dc_guard))
     {
-      sample_real[new_idx] = cic_correct(bin, filter_control.fft_bin, sample_real[fft_size - (new_fft_size/2u) + i + 1]);
-      sample_imag[new_idx] = cic_correct(bin, filter_control.fft_bin, sample_imag[fft_size - (new_fft_size/2u) + i + 1]);
+      output_real[bin] = 0;
+      output_imag[bin] = 0;
+      output_real[bin+1] = 0;
+      output_imag[bin+1] = 0;
+      output_real[bin-1] = 0;
+      output_imag[bin-1] = 0;
+    }
+  }
+}
 
-      //capture highest and second highest peak
-      uint16_t magnitude = rectangular_2_magnitude(sample_real[new_idx], sample_imag[new_idx]);
-      if(magnitude > peak)
-      {
-        peak = magnitude; 
-        peak_bin = i;
-      }
-      else if(magnitude > next_peak)
-      {
-        next_peak = magnitude;
-      }
+template <uint8_t order>
+void fft_filter<order>::filter_block(s_filter_control &filter_control, int16_t capture[]) {
+
+  int16_t *sample_real = frame_real;
+  int16_t *sample_imag = frame_imag;
+  const int16_t *window = fft_window<order>.window;
+  const uint16_t *bin_map = fft_bin_map<order>.source;
+
+  // window
+  for (uint16_t i = 0; i < fft_size; i++) {
+    sample_real[i] = product(sample_real[i], window[i]);
+    sample_imag[i] = product(sample_imag[i], window[i]);
+  }
+
+  // forward FFT
+  fixed_fft<order>(sample_real, sample_imag);
+
+  // Rather than shifting the tuned frequency to DC in the time domain, the
+  // spectrum can be rotated so that bin fft_bin becomes bin 0. For a shift of
+  // k bins, each frame also picks up a phase of -pi*k relative to the last
+  // (the frames advance by fft_size/2 samples), so frames must be negated
+  // alternately when k is odd.
+  const uint16_t rotation = filter_control.rotate_bins?(filter_control.fft_bin & (fft_size - 1)):0;
+  const bool negate = filter_control.rotate_bins && (filter_control.fft_bin & 1) && odd_frame;
+  odd_frame = !odd_frame;
+
+  if(filter_control.capture)
+  {
+    for (uint16_t i = 0; i < fft_size; i++) {
+      const uint16_t bin = (i + rotation) & (fft_size - 1);
+      capture[i] = (((int32_t)capture[i]<<3) - capture[i] + rectangular_2_magnitude(sample_real[bin], sample_imag[bin])) >> 3;
     }
   }
 
+  //over-subtraction (4 fraction bits) and minimum gain (8 fraction bits) for
+  //each noise reduction strength
+  static const uint8_t nr_over_subtraction[4] = {0, 32, 48, 64};
+  static const uint8_t nr_minimum_gain[4] = {0, 64, 32, 16};
+  const uint8_t nr_strength = std::min(filter_control.noise_reduction, (uint8_t)3u);
+  const uint16_t over_subtraction = nr_over_subtraction[nr_strength];
+  const uint16_t minimum_gain = nr_minimum_gain[nr_strength];
+
+  //candidate carriers for the auto notch
+  s_peak_finder peaks;
+
+  //pass band and cic correction, bins outside the pass band have no gain
+  const uint16_t *gains = update_gains(main_gains, filter_control);
+  for (uint16_t i = 0; i < new_fft_size; i++) {
+    const uint16_t bin = (bin_map[i] + rotation) & (fft_size - 1);
+    const uint16_t gain = gains[i];
+    output_real[i] = apply_gain(sample_real[bin], gain);
+    output_imag[i] = apply_gain(sample_imag[bin], gain);
+
+    const uint16_t magnitude = rectangular_2_magnitude(output_real[i], output_imag[i]);
+    peaks.add(i, magnitude);
+
+    if(nr_strength && gain) reduce_noise(i, magnitude, over_subtraction, minimum_gain);
+  }
+
   if(filter_control.enable_auto_notch)
   {
-    //check for a consistent
-    const uint8_t confirm_threshold = 255u;
-    static uint8_t confirm_count = 0u;
-    static uint8_t last_peak_bin = 0u;
-    if(peak_bin == last_peak_bin && confirm_count < confirm_threshold) confirm_count++;
-    if(peak_bin != last_peak_bin && confirm_count > 0) confirm_count--;
-    last_peak_bin = peak_bin;
-
-    //remove highest bin
-    if((confirm_count > confirm_threshold/2u) && (peak_bin > 3u) && (peak_bin < new_fft_size-3u))
-    {
-      sample_real[peak_bin] = 0;
-      sample_imag[peak_bin] = 0;
-      sample_real[peak_bin+1] = 0;
-      sample_imag[peak_bin+1] = 0;
-      sample_real[peak_bin-1] = 0;
-      sample_imag[peak_bin-1] = 0;
-    }
+    auto_notch(peaks);
   }
 
+  if(negate)
+  {
+    for (uint16_t i = 0; i < new_fft_size; i++) {
+      output_real[i] = -output_real[i];
+      output_imag[i] = -output_imag[i];
+    }
+  }
 
   // inverse FFT
-  fixed_ifft(sample_real, sample_imag, 7);
+  fixed_ifft<order-1>(output_real, output_imag);
 
 }
 
 
-#ifndef SIMULATION
-void __not_in_flash_func(fft_filter::process_sample)(int16_t sample_real[], int16_t sample_imag[], s_filter_control &filter_control, int16_t capture[]) {
-#else
-void fft_filter::process_sample(int16_t sample_real[], int16_t sample_imag[], s_filter_control &filter_control, int16_t capture[]) {
-#endif
-
-  int16_t real[fft_size];
-  int16_t imag[fft_size];
+template <uint8_t order>
+void fft_filter<order>::process_sample(int16_t sample_real[], int16_t sample_imag[], s_filter_control &filter_control, int16_t capture[]) {
 
   for (uint16_t i = 0; i < (fft_size/2u); i++) {
-    real[i] = last_input_real[i];
-    imag[i] = last_input_imag[i];
-    real[fft_size/2u + i] = sample_real[i];
-    imag[fft_size/2u + i] = sample_imag[i];
+    frame_real[i] = last_input_real[i];
+    frame_imag[i] = last_input_imag[i];
+    frame_real[fft_size/2u + i] = sample_real[i];
+    frame_imag[fft_size/2u + i] = sample_imag[i];
     last_input_real[i] = sample_real[i];
     last_input_imag[i] = sample_imag[i];
   }
 
   //filter combined block
-  filter_block(real, imag, filter_control, capture);
+  filter_block(filter_control, capture);
+
+  for (uint16_t i = 0; i < (new_fft_size/2u); i++) {
+    sample_real[i] = output_real[i] + last_output_real[i];
+    sample_imag[i] = output_imag[i] + last_output_imag[i];
+    last_output_real[i] = output_real[new_fft_size/2u + i];
+    last_output_imag[i] = output_imag[new_fft_size/2u + i];
+  }
+
+}
+
+//A dual watch channel only needs another inverse fft, since the forward fft
+//of the frame is still in frame_real/frame_imag. Noise reduction and the auto
+//notch are left to the main channel. The output buffers are free once
+//process_sample has returned, so they are reused here.
+template <uint8_t order>
+void fft_filter<order>::process_sub_channel(int16_t sample_real[], int16_t sample_imag[], const s_filter_control &filter_control, uint16_t rotation) {
+
+  const uint16_t *bin_map = fft_bin_map<order>.source;
+  rotation &= fft_size - 1;
+
+  //odd_frame has already been toggled for the frame in frame_real/frame_imag
+  const bool negate = (rotation & 1) && !odd_frame;
+
+  const uint16_t *gains = update_gains(sub_gains, filter_control);
+  for (uint16_t i = 0; i < new_fft_size; i++) {
+    const uint16_t bin = (bin_map[i] + rotation) & (fft_size - 1);
+    output_real[i] = apply_gain(frame_real[bin], gains[i]);
+    output_imag[i] = apply_gain(frame_imag[bin], gains[i]);
+  }
+
+  if(negate)
+  {
+    for (uint16_t i = 0; i < new_fft_size; i++) {
+      output_real[i] = -output_real[i];
+      output_imag[i] = -output_imag[i];
+    }
+  }
+
+  // inverse FFT
+  fixed_ifft<order-1>(output_real, output_imag);
 
   for (uint16_t i = 0; i < (new_fft_size/2u); i++) {
-    sample_real[i] = real[i] + last_output_real[i];
-    sample_imag[i] = imag[i] + last_output_imag[i];
-    last_output_real[i] = real[new_fft_size/2u + i];
-    last_output_imag[i] = imag[new_fft_size/2u + i];
+    sample_real[i] = output_real[i] + sub_last_output_real[i];
+    sample_imag[i] = output_imag[i] + sub_last_output_imag[i];
+    sub_last_output_real[i] = output_real[new_fft_size/2u + i];
+    sub_last_output_imag[i] = output_imag[new_fft_size/2u + i];
   }
 
 }
+
+//the host build instantiates every supported size so that they can all be tested
+//(section attributes only take effect on the explicit instantiation)
+#ifdef SIMULATION
+template class fft_filter<8>;
+template class fft_filter<9>;
+template class fft_filter<10>;
+#else
+template void __not_in_flash_func(fft_filter<FFT_ORDER>::filter_block)(s_filter_control &filter_control, int16_t capture[]);
+template void __not_in_flash_func(fft_filter<FFT_ORDER>::auto_notch)(const s_peak_finder &peaks);
+template const uint16_t *__not_in_flash_func(fft_filter<FFT_ORDER>::update_gains)(fft_filter<FFT_ORDER>::s_bin_gains &gains, const s_filter_control &filter_control);
+template void __not_in_flash_func(fft_filter<FFT_ORDER>::process_sample)(int16_t sample_real[], int16_t sample_imag[], s_filter_control &filter_control, int16_t capture[]);
+template void __not_in_flash_func(fft_filter<FFT_ORDER>::process_sub_channel)(int16_t sample_real[], int16_t sample_imag[], const s_filter_control &filter_control, uint16_t rotation);
+template class fft_filter<FFT_ORDER>;
+#endif
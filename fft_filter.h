@@ -18,9 +18,6 @@
 
 #include "fft.h"
 
-static const uint16_t fft_size = 256;
-static const uint16_t new_fft_size = fft_size/2; 
-
 struct s_filter_control
 {
   uint16_t start_bin; 
@@ -30,26 +27,147 @@ struct s_filter_control
   bool upper_sideband; 
   bool capture;
   bool enable_auto_notch;
+  bool rotate_bins; //move the tuned frequency (fft_bin) to DC by rotating the spectrum
+  uint8_t noise_reduction; //0 = off, 1-3 = increasing strength
+};
+
+//Finds the largest local maxima in one pass over the spectrum. Bins are fed
+//in packed index order (DC and the positive frequencies, then the negative
+//frequencies), which is not monotonic in frequency. A bin is known to be a
+//peak once the bin after it in that order is no larger. Neighbouring indices
+//are neighbouring frequencies except at the jump from the highest positive
+//to the lowest negative bin, and both of those are outside the pass band.
+struct s_peak_finder
+{
+  static const uint8_t max_peaks = 4;
+  uint16_t bin[max_peaks];
+  uint16_t magnitude[max_peaks];
+  uint16_t last_magnitude;
+  bool rising;
+
+  s_peak_finder() : last_magnitude(0), rising(false)
+  {
+    for(uint8_t i = 0; i < max_peaks; ++i) magnitude[i] = 0;
+  }
+
+  inline __attribute__((always_inline)) void add(uint16_t idx, uint16_t this_magnitude)
+  {
+    if(rising && this_magnitude <= last_magnitude && last_magnitude > magnitude[max_peaks - 1])
+    {
+      insert(idx - 1, last_magnitude);
+    }
+    rising = this_magnitude > last_magnitude;
+    last_magnitude = this_magnitude;
+  }
+
+  //keep peaks sorted, largest first
+  inline __attribute__((always_inline)) void insert(uint16_t peak_bin, uint16_t peak_magnitude)
+  {
+    uint8_t i = max_peaks - 1;
+    while(i > 0 && magnitude[i - 1] < peak_magnitude)
+    {
+      bin[i] = bin[i - 1];
+      magnitude[i] = magnitude[i - 1];
+      i--;
+    }
+    bin[i] = peak_bin;
+    magnitude[i] = peak_magnitude;
+  }
+};
+
+//raised cosine window, generated at compile time
+template <uint8_t order>
+struct s_fft_window
+{
+  static const uint16_t fft_size = 1u << order;
+  int16_t window[fft_size];
+  constexpr s_fft_window() : window()
+  {
+    for (uint16_t i = 0; i < fft_size; i++) {
+      window[i] = constexpr_float2fixed(0.5 * (1.0 - constexpr_cos(2.0*constexpr_pi*i/fft_size)));
+    }
+  }
 };
 
+//The filtered spectrum is packed into an fft of half the size, DC and
+//positive frequencies first, then negative frequencies. This gives the bin
+//of the full fft that feeds each bin of the packed spectrum.
+template <uint8_t order>
+struct s_fft_bin_map
+{
+  static const uint16_t fft_size = 1u << order;
+  static const uint16_t new_fft_size = fft_size/2;
+  uint16_t source[new_fft_size];
+  constexpr s_fft_bin_map() : source()
+  {
+    for (uint16_t i = 0; i < new_fft_size; i++) {
+      source[i] = (i <= new_fft_size/2u) ? i : fft_size - new_fft_size + i;
+    }
+  }
+};
+
+//not const, so that the tables are placed in RAM
+template <uint8_t order>
+s_fft_window<order> fft_window;
+template <uint8_t order>
+s_fft_bin_map<order> fft_bin_map;
+
+template <uint8_t order>
 class fft_filter
 {
 
+  public:
+  static const uint16_t fft_size = 1u << order;
+  static const uint16_t new_fft_size = fft_size/2; 
+
+  private:
   int16_t last_input_real[fft_size/2u];
   int16_t last_input_imag[fft_size/2u];
   int16_t last_output_real[new_fft_size/2];
   int16_t last_output_imag[new_fft_size/2];
-  int32_t window[fft_size];
-  void filter_block(int16_t sample_real[], int16_t sample_imag[], s_filter_control &filter_control, int16_t capture[]);
+  int16_t sub_last_output_real[new_fft_size/2];
+  int16_t sub_last_output_imag[new_fft_size/2];
+
+  //working buffers, kept off the stack since they get large
+  int16_t frame_real[fft_size];
+  int16_t frame_imag[fft_size];
+  int16_t output_real[new_fft_size];
+  int16_t output_imag[new_fft_size];
+
+  bool odd_frame;
+
+  //noise reduction, per bin of the packed spectrum
+  uint32_t noise_floor[new_fft_size]; //8 fraction bits
+  uint16_t noise_gain[new_fft_size]; //8 fraction bits
+  void reduce_noise(uint16_t idx, uint16_t magnitude, uint16_t over_subtraction, uint16_t minimum_gain);
+
+  //auto notch, tracks up to max_notches carriers that persist from frame to frame
+  static const uint8_t max_notches = s_peak_finder::max_peaks;
+  uint16_t notch_bin[max_notches];
+  uint8_t notch_count[max_notches];
+  void auto_notch(const s_peak_finder &peaks);
+
+  //gain of each bin of the packed spectrum (8 fraction bits), zero outside
+  //the pass band, otherwise the cic correction for the frequency of the bin.
+  //The table is only rebuilt when the pass band or tuning changes, so the
+  //per frame loop is a single multiply for every bin, and any pass band
+  //shape can be built in at no extra cost per frame.
+  struct s_bin_gains
+  {
+    uint16_t gain[new_fft_size];
+    s_filter_control passband; //the settings that the gains were built for
+    bool valid;
+  };
+  s_bin_gains main_gains;
+  s_bin_gains sub_gains;
+  const uint16_t *update_gains(s_bin_gains &gains, const s_filter_control &filter_control);
+
+  void filter_block(s_filter_control &filter_control, int16_t capture[]);
 
   public:
   fft_filter()
   {
-    fft_initialise();
-    for (uint16_t i = 0; i < fft_size; i++) {
-      float multiplier = 0.5 * (1 - cosf(2*M_PI*i/fft_size));
-      window[i] = float2fixed(multiplier);
-    }
+    odd_frame = false;
     for (uint16_t i = 0; i < fft_size/2u; i++) {
       last_input_real[i] = 0;
       last_input_imag[i] = 0;
@@ -57,9 +175,26 @@ class fft_filter
     for (uint16_t i = 0; i < new_fft_size/2; i++) {
       last_output_real[i] = 0;
       last_output_imag[i] = 0;
+      sub_last_output_real[i] = 0;
+      sub_last_output_imag[i] = 0;
+    }
+    for (uint16_t i = 0; i < new_fft_size; i++) {
+      noise_floor[i] = 0;
+      noise_gain[i] = 256;
+    }
+    for (uint8_t i = 0; i < max_notches; i++) {
+      notch_bin[i] = 0;
+      notch_count[i] = 0;
     }
+    main_gains.valid = false;
+    sub_gains.valid = false;
   }
+  //filter fft_size/2 new samples in place, giving new_fft_size/2 samples at half the sample rate
   void process_sample(int16_t sample_real[], int16_t sample_imag[], s_filter_control &filter_control, int16_t capture[]);
+  //filter a second channel from the spectrum of the frame that process_sample has just
+  //filtered, giving another new_fft_size/2 samples. The spectrum is rotated by rotation
+  //bins, and filter_control.fft_bin gives the frequency of the channel for cic correction.
+  void process_sub_channel(int16_t sample_real[], int16_t sample_imag[], const s_filter_control &filter_control, uint16_t rotation);
 
 };
 
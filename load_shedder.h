@@ -0,0 +1,90 @@
+#ifndef LOAD_SHEDDER_H
+#define LOAD_SHEDDER_H
+
+#include <stdint.h>
+
+//Adaptive load shedding
+//
+//Watches the time taken to process each block against the time between
+//blocks. When a deadline is missed (the next block had already completed by
+//the time processing finished), or the average load stays too high, the
+//receiver moves one step down a ladder of features that can be given up
+//without losing audio. Once there has been plenty of headroom for a while,
+//features are restored one step at a time. The maximum step is a setting,
+//so shedding can be limited or turned off.
+
+//steps of the ladder, each also includes the ones before it
+enum e_shed_level
+{
+  shed_none,
+  shed_auto_notch,     //auto notch off
+  shed_iq_estimation,  //iq imbalance correction is applied, but not updated
+  shed_spectrum,       //spectrum and waterfall stop updating
+  num_shed_levels
+};
+
+class load_shedder
+{
+  static const uint16_t shed_load = 240;        //~94% of the block time (8 fraction bits)
+  static const uint16_t restore_load = 180;     //~70%
+  static const uint16_t settle_blocks = 64;     //after a change, wait for the load to settle
+  static const uint16_t restore_blocks = 1024;  //blocks of headroom needed to restore a step
+
+  uint8_t max_level;
+  uint8_t level;
+  uint16_t average_load;  //8 fraction bits
+  uint16_t settle;
+  uint16_t headroom;
+  uint32_t deadline_misses;
+
+  public:
+  load_shedder() :
+    max_level(0), level(0), average_load(0), settle(0), headroom(0), deadline_misses(0)
+  {
+  }
+
+  //0 never sheds anything, up to num_shed_levels-1 allows the whole ladder
+  void set_max_level(uint8_t max)
+  {
+    max_level = max < num_shed_levels ? max : num_shed_levels - 1;
+    if(level > max_level) level = max_level;
+  }
+
+  //call once per block with the processing time and the time between blocks
+  //(in the same units), returns the step of the ladder now in use
+  uint8_t update(uint32_t busy_time, uint32_t block_time, bool missed_deadline)
+  {
+    const uint32_t load = ((uint64_t)busy_time << 8) / block_time;
+    const uint16_t clamped_load = load > 512 ? 512 : load;
+    average_load = average_load - (average_load >> 3) + (clamped_load >> 3);
+    if(missed_deadline) deadline_misses++;
+
+    if(average_load >= restore_load || missed_deadline) headroom = 0;
+    else if(headroom < restore_blocks) headroom++;
+    if(settle)
+    {
+      settle--;
+      return level;
+    }
+
+    if((missed_deadline || average_load > shed_load) && level < max_level)
+    {
+      level++;
+      settle = settle_blocks;
+      headroom = 0;
+    }
+    else if(headroom >= restore_blocks && level > 0)
+    {
+      level--;
+      settle = settle_blocks;
+      headroom = 0;
+    }
+    return level;
+  }
+
+  uint8_t get_level() const { return level; }
+  uint32_t get_deadline_misses() const { return deadline_misses; }
+  uint16_t get_average_load() const { return average_load; }
+};
+
+#endif
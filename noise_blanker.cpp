@@ -0,0 +1,67 @@
+#include "noise_blanker.h"
+#include "pico/stdlib.h"
+#include <algorithm>
+#include <cstdlib>
+
+noise_blanker :: noise_blanker()
+{
+  for(uint8_t channel=0; channel<2; ++channel)
+  {
+    dc[channel] = 2048 << 8;
+    //start high and settle down, rather than blanking everything at first
+    average[channel] = 2048 << 8;
+  }
+  hold = 0;
+  threshold = 0;
+  impulse_count = 0;
+  blanked_count = 0;
+}
+
+void noise_blanker :: set_threshold(uint8_t ratio)
+{
+  threshold = ratio;
+}
+
+void __not_in_flash_func(noise_blanker :: process_block)(uint16_t samples[])
+{
+  if(!threshold) return;
+
+  //work on local copies so that the state stays in registers
+  int32_t dc_even = dc[0], dc_odd = dc[1];
+  int32_t average_even = average[0], average_odd = average[1];
+  uint16_t hold_pairs = hold;
+  uint32_t impulses = 0;
+  uint32_t blanked = 0;
+
+  for(uint16_t idx=0; idx<adc_block_size; idx+=2)
+  {
+    const int32_t even = (int32_t)samples[idx] << 8;
+    const int32_t odd = (int32_t)samples[idx+1] << 8;
+    const int32_t deviation_even = abs(even - dc_even);
+    const int32_t deviation_odd = abs(odd - dc_odd);
+    const int32_t limit_even = average_even * threshold + nb_minimum_limit;
+    const int32_t limit_odd = average_odd * threshold + nb_minimum_limit;
+
+    //an impulse on either channel (re)starts the blanking period
+    const bool impulse = (deviation_even > limit_even) | (deviation_odd > limit_odd);
+    impulses += impulse & (hold_pairs == 0);
+    hold_pairs = impulse ? nb_hold_pairs : hold_pairs - (hold_pairs != 0);
+    const bool blank = hold_pairs != 0;
+    blanked += blank;
+
+    samples[idx] = blank ? dc_even >> 8 : samples[idx];
+    samples[idx+1] = blank ? dc_odd >> 8 : samples[idx+1];
+
+    //dc is held while blanking, the averages are limited to the threshold
+    dc_even += blank ? 0 : (even - dc_even) >> 10;
+    dc_odd += blank ? 0 : (odd - dc_odd) >> 10;
+    average_even += (std::min(deviation_even, limit_even) - average_even) >> 8;
+    average_odd += (std::min(deviation_odd, limit_odd) - average_odd) >> 8;
+  }
+
+  dc[0] = dc_even; dc[1] = dc_odd;
+  average[0] = average_even; average[1] = average_odd;
+  hold = hold_pairs;
+  impulse_count += impulses;
+  blanked_count += blanked;
+}
@@ -0,0 +1,38 @@
+#ifndef NOISE_BLANKER_H
+#define NOISE_BLANKER_H
+
+#include <stdint.h>
+#include "rx_definitions.h"
+
+//Impulse noise blanker
+//
+//Works on the raw interleaved ADC samples, before the CIC decimator spreads
+//an impulse over many output samples. Each channel tracks its DC level and
+//average deviation from it. When either channel deviates by more than
+//threshold times its average, both are replaced by their DC level (so the
+//blanked signal is zero) for the next nb_hold_pairs sample pairs. The
+//averages only see deviations up to the threshold, so the impulses
+//themselves don't raise it.
+class noise_blanker
+{
+  static const uint16_t nb_hold_pairs = 8;      //~33us at 240kHz per channel
+  static const int32_t nb_minimum_limit = 16<<8; //ignore impulses below 16 LSBs
+
+  int32_t dc[2];       //8 fraction bits
+  int32_t average[2];  //8 fraction bits
+  uint16_t hold;
+  uint8_t threshold;   //0 = off
+  uint32_t impulse_count;
+  uint32_t blanked_count;
+
+  public:
+  noise_blanker();
+  void set_threshold(uint8_t ratio);
+  //blank adc_block_size interleaved samples in place
+  void process_block(uint16_t samples[]);
+  //running totals, for monitoring
+  uint32_t get_impulse_count() const { return impulse_count; }
+  uint32_t get_blanked_count() const { return blanked_count; }
+};
+
+#endif
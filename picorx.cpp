@@ -36,6 +36,10 @@ int main()
   // create an alarm pool for USB streaming with highest priority (0), so
   // that it can pre-empt the default pool
   receiver.set_alarm_pool(alarm_pool_create(0, 16));
+#ifdef DUAL_CORE_DSP
+  //the second half of the DSP runs on this core, in an interrupt
+  receiver.start_back_end();
+#endif
   user_interface.autorestore();
 
   uint32_t last_ui_update = 0;
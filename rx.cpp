@@ -17,24 +17,22 @@ static ring_buffer_t usb_ring_buffer;
 static uint8_t usb_buf[USB_BUF_SIZE];
 
 //buffers and dma for ADC
-int rx::adc_dma_ping;
-int rx::adc_dma_pong;
-dma_channel_config rx::ping_cfg;
-dma_channel_config rx::pong_cfg;
-uint16_t rx::ping_samples[adc_block_size];
-uint16_t rx::pong_samples[adc_block_size];
+int rx::adc_dma;
+int rx::adc_control_dma;
+dma_channel_config rx::adc_cfg;
+dma_channel_config rx::adc_control_cfg;
+uint16_t rx::adc_ring[max_dma_ring_depth][adc_block_size];
+s_dma_control_list rx::adc_control_list;
+volatile uint32_t rx::adc_blocks_written;
 
 //buffers and dma for PWM audio output
 int rx::audio_pwm_slice_num;
-int rx::pwm_dma_ping;
-int rx::pwm_dma_pong;
-dma_channel_config rx::audio_ping_cfg;
-dma_channel_config rx::audio_pong_cfg;
-int16_t rx::ping_audio[adc_block_size];
-int16_t rx::pong_audio[adc_block_size];
-bool rx::audio_running;
-uint16_t rx::num_ping_samples;
-uint16_t rx::num_pong_samples;
+int rx::pwm_dma;
+int rx::pwm_control_dma;
+dma_channel_config rx::audio_cfg;
+dma_channel_config rx::audio_control_cfg;
+int16_t rx::audio_ring[max_dma_ring_depth][pwm_block_size];
+s_dma_control_list rx::audio_control_list;
 
 //dma for capture
 int rx::capture_dma;
@@ -42,44 +40,21 @@ dma_channel_config rx::capture_cfg;
 
 void rx::dma_handler() {
 
-
-    // adc ping             ####    ####
-    // adc pong                 ####    ####
-    // processing ping          ### 
-    // processing pong              ###
-    // pwm_ping                     ####
-    // pwm_pong                         ####
-
-    if(dma_hw->ints0 & (1u << adc_dma_ping))
-    {
-      dma_channel_configure(adc_dma_ping, &ping_cfg, ping_samples, &adc_hw->fifo, adc_block_size, false);
-      if(audio_running){
-        dma_channel_configure(pwm_dma_pong, &audio_pong_cfg, &pwm_hw->slice[audio_pwm_slice_num].cc, pong_audio, num_pong_samples, true);
-      }
-      dma_hw->ints0 = 1u << adc_dma_ping;
-    }
-
-    if(dma_hw->ints0 & (1u << adc_dma_pong))
-    {
-      dma_channel_configure(adc_dma_pong, &pong_cfg, pong_samples, &adc_hw->fifo, adc_block_size, false);
-      dma_channel_configure(pwm_dma_ping, &audio_ping_cfg, &pwm_hw->slice[audio_pwm_slice_num].cc, ping_audio, num_ping_samples, true);
-      if(!audio_running){
-        audio_running = true;
-      }
-      dma_hw->ints0 = 1u << adc_dma_pong;
-    }
+    //the ring re-arms itself in hardware, just count completed adc blocks
+    dma_hw->ints0 = 1u << adc_dma;
+    adc_blocks_written++;
 
 }
 
-void rx::access(bool s)
+void rx::publish_settings(bool s)
 {
-  sem_acquire_blocking(&settings_semaphore);
-  settings_changed |= s;
+  settings_exchange.write(settings_to_apply);
+  if(s) settings_version = settings_version + 1;
 }
 
-void rx::release()
+void rx::refresh_status()
 {
-  sem_release(&settings_semaphore);
+  status_exchange.read(status);
 }
 
 void rx::pwm_ramp_down()
@@ -122,140 +97,164 @@ void rx::pwm_ramp_up()
 
 void rx::update_status()
 {
-   if(sem_try_acquire(&settings_semaphore))
-   {
-     suspend = settings_to_apply.suspend;
-
-     //update status
-     status.signal_strength_dBm = rx_dsp_inst.get_signal_strength_dBm();
-     status.busy_time = busy_time;
-     status.battery = battery;
-     status.temp = temp;
-     status.filter_config = rx_dsp_inst.get_filter_config();
-     static uint16_t avg_level = 0;
-     avg_level = (avg_level - (avg_level >> 2)) + (ring_buffer_get_num_bytes(&usb_ring_buffer) >> 2);
-     status.usb_buf_level = 100 * avg_level / USB_BUF_SIZE;
-     sem_release(&settings_semaphore);
-   }
+   //only suspend is needed here, if core 0 is part way through publishing
+   //new settings keep the last value rather than wait
+   rx_settings latest_settings;
+   if(settings_exchange.try_read(latest_settings)) suspend = latest_settings.suspend;
+
+   //update status
+   current_status.signal_strength_dBm = rx_dsp_inst.get_signal_strength_dBm();
+#ifdef DUAL_CORE_DSP
+   //the slower stage limits the pipeline
+   current_status.busy_time = std::max(busy_time, back_end_busy_time);
+#else
+   current_status.busy_time = busy_time;
+#endif
+   current_status.battery = battery;
+   current_status.temp = temp;
+   current_status.filter_config = rx_dsp_inst.get_filter_config();
+   current_status.noise_blanker_impulses = rx_dsp_inst.get_noise_blanker_impulses();
+   current_status.dual_watch_bin = rx_dsp_inst.get_dual_watch_bin();
+   current_status.dma_overruns = adc_pwm_ring.get_overruns();
+   current_status.dma_underruns = adc_pwm_ring.get_underruns();
+   current_status.deadline_misses = load_shedder_inst.get_deadline_misses();
+   current_status.shed_level = shed_level;
+#ifdef DSP_PROFILE
+   rx_dsp_inst.profiler.get_stats(current_status.profile);
+   current_status.cycles_per_us = clock_get_hz(clk_sys) / 1000000u;
+#endif
+   usb_buf_level_avg = (usb_buf_level_avg - (usb_buf_level_avg >> 2)) + (ring_buffer_get_num_bytes(&usb_ring_buffer) >> 2);
+   current_status.usb_buf_level = 100 * usb_buf_level_avg / USB_BUF_SIZE;
+   status_exchange.write(current_status);
 }
 
 void rx::apply_settings()
 {
-   if(sem_try_acquire(&settings_semaphore))
-   {
-
-      //apply frequency
-      tuned_frequency_Hz = settings_to_apply.tuned_frequency_Hz;
-
-      //apply frequency calibration
-      tuned_frequency_Hz *= 1e6/(1e6+settings_to_apply.ppm);
-
-      uint32_t system_clock_rate;
-      nco_frequency_Hz = nco_set_frequency(pio, sm, tuned_frequency_Hz, system_clock_rate);
-      offset_frequency_Hz = tuned_frequency_Hz - nco_frequency_Hz;
-
-      if(tuned_frequency_Hz > (settings_to_apply.band_7_limit * 125000))
-      {
-        gpio_put(2, 0);
-        gpio_put(3, 0);
-        gpio_put(4, 0);
-      }
-      else if(tuned_frequency_Hz > (settings_to_apply.band_6_limit * 125000))
-      {
-        gpio_put(2, 1);
-        gpio_put(3, 0);
-        gpio_put(4, 0);
-      }
-      else if(tuned_frequency_Hz > (settings_to_apply.band_5_limit * 125000))
-      {
-        gpio_put(2, 0);
-        gpio_put(3, 1);
-        gpio_put(4, 0);
-      }
-      else if(tuned_frequency_Hz > (settings_to_apply.band_4_limit * 125000))
-      {
-        gpio_put(2, 1);
-        gpio_put(3, 1);
-        gpio_put(4, 0);
-      }
-      else if(tuned_frequency_Hz > (settings_to_apply.band_3_limit * 125000))
-      {
-        gpio_put(2, 0);
-        gpio_put(3, 0);
-        gpio_put(4, 1);
-      }
-      else if(tuned_frequency_Hz > (settings_to_apply.band_2_limit * 125000))
-      {
-        gpio_put(2, 1);
-        gpio_put(3, 0);
-        gpio_put(4, 1);
-      }
-      else if(tuned_frequency_Hz > (settings_to_apply.band_1_limit * 125000))
-      {
-        gpio_put(2, 0);
-        gpio_put(3, 1);
-        gpio_put(4, 1);
-      }
-      else
-      {
-        gpio_put(2, 1);
-        gpio_put(3, 1);
-        gpio_put(4, 1);
-      }
-
-      //apply pwm_max
-      pwm_max = (system_clock_rate/audio_sample_rate)-1;
-      pwm_scale = 1+((INT16_MAX * 2)/pwm_max);
-      pwm_set_wrap(audio_pwm_slice_num, pwm_max); 
-
-      //apply frequency offset
-      rx_dsp_inst.set_frequency_offset_Hz(offset_frequency_Hz);
-
-      //apply CW sidetone
-      rx_dsp_inst.set_cw_sidetone_Hz(settings_to_apply.cw_sidetone_Hz);
-
-      //apply gain calibration
-      rx_dsp_inst.set_gain_cal_dB(settings_to_apply.gain_cal);
-
-      //apply AGC speed
-      rx_dsp_inst.set_agc_speed(settings_to_apply.agc_speed);
-
-      //apply Automatic Notch Filter
-      rx_dsp_inst.set_auto_notch(settings_to_apply.enable_auto_notch);
-
-      //apply mode
-      rx_dsp_inst.set_mode(settings_to_apply.mode, settings_to_apply.bandwidth);
-
-      //apply volume
-      static const int16_t gain[] = {
-        0,   // 0 = 0/256 -infdB
-        16,  // 1 = 16/256 -24dB
-        23,  // 2 = 23/256 -21dB
-        32,  // 3 = 32/256 -18dB
-        45,  // 4 = 45/256 -15dB
-        64,  // 5 = 64/256 -12dB
-        90,  // 6 = 90/256  -9dB
-        128, // 7 = 128/256 -6dB
-        180, // 8 = 180/256 -3dB
-        256  // 9 = 256/256  0dB
-      };
-      gain_numerator = gain[settings_to_apply.volume];
-
-      //apply deemphasis
-      rx_dsp_inst.set_deemphasis(settings_to_apply.deemphasis);
-
-      //apply squelch
-      rx_dsp_inst.set_squelch(settings_to_apply.squelch);
-
-      //apply swap iq
-      rx_dsp_inst.set_swap_iq(settings_to_apply.swap_iq);
+  //changes published after this point are applied next time
+  const uint32_t version = settings_version;
+  settings_exchange.read(settings);
+
+  //apply frequency
+  tuned_frequency_Hz = settings.tuned_frequency_Hz;
+
+  //apply frequency calibration
+  tuned_frequency_Hz *= 1e6/(1e6+settings.ppm);
+
+  uint32_t system_clock_rate;
+  nco_frequency_Hz = nco_set_frequency(pio, sm, tuned_frequency_Hz, system_clock_rate);
+  offset_frequency_Hz = tuned_frequency_Hz - nco_frequency_Hz;
+
+  //select the band filter, the select lines count down as the bands go up
+  const uint8_t band_limits[num_bands - 1] = {
+    settings.band_1_limit, settings.band_2_limit, settings.band_3_limit, settings.band_4_limit,
+    settings.band_5_limit, settings.band_6_limit, settings.band_7_limit};
+  uint8_t band = num_bands - 1;
+  while(band > 0 && !(tuned_frequency_Hz > (band_limits[band - 1] * 125000))) band--;
+  const uint8_t band_select = num_bands - 1 - band;
+  gpio_put(2, band_select & 1);
+  gpio_put(3, (band_select >> 1) & 1);
+  gpio_put(4, (band_select >> 2) & 1);
+
+  //estimates made with i and q the other way round are no use
+  if(settings.swap_iq != band_estimates_swap_iq)
+  {
+    for(bool &valid : band_estimate_valid) valid = false;
+    band_estimates_swap_iq = settings.swap_iq;
+    current_band = num_bands;
+  }
 
-      //apply iq imbalance correction
-      rx_dsp_inst.set_iq_correction(settings_to_apply.iq_correction);
+  //keep the dc and iq imbalance estimates for the band being left, and
+  //carry on from where the new band left off rather than from scratch
+  if(band != current_band)
+  {
+    if(current_band < num_bands)
+    {
+      rx_dsp_inst.get_iq_dc_estimate(band_estimates[current_band]);
+      band_estimate_valid[current_band] = true;
+    }
+    if(band_estimate_valid[band]) rx_dsp_inst.set_iq_dc_estimate(band_estimates[band]);
+    current_band = band;
+  }
 
-      settings_changed = false;
-      sem_release(&settings_semaphore);
-   }
+  //apply pwm_max
+  pwm_max = (system_clock_rate/audio_sample_rate)-1;
+  pwm_scale = 1+((INT16_MAX * 2)/pwm_max);
+  pwm_set_wrap(audio_pwm_slice_num, pwm_max); 
+
+  //apply frequency offset
+  rx_dsp_inst.set_frequency_offset_Hz(offset_frequency_Hz);
+
+  //apply buffering, the dma ring is restarted after settings are applied
+#ifdef DUAL_CORE_DSP
+  //the pipeline adds a block of latency, which needs the deepest ring
+  dma_ring_depth = dma_ring::valid_depth(max_dma_ring_depth);
+#else
+  dma_ring_depth = dma_ring::valid_depth(settings.dma_ring_depth);
+#endif
+
+  //apply load shedding, lowering the limit restores features straight away
+  load_shedder_inst.set_max_level(settings.load_shedding);
+  shed_level = load_shedder_inst.get_level();
+  rx_dsp_inst.set_load_shedding(shed_level);
+
+  //apply dual watch, the watched frequency must lie within the spectrum around the NCO
+  //a watched frequency that was never set (erased flash) watches the tuned one
+  dual_watch = settings.dual_watch;
+  const bool dual_watch_frequency_set = settings.dual_watch_frequency_Hz != 0xffffffffu;
+  const double watched_frequency_Hz = dual_watch_frequency_set ? settings.dual_watch_frequency_Hz : settings.tuned_frequency_Hz;
+  const double dual_watch_frequency_Hz = watched_frequency_Hz * 1e6/(1e6+settings.ppm);
+  rx_dsp_inst.set_dual_watch(dual_watch != 0, dual_watch_frequency_Hz - nco_frequency_Hz);
+
+  //apply CW sidetone
+  rx_dsp_inst.set_cw_sidetone_Hz(settings.cw_sidetone_Hz);
+
+  //apply gain calibration
+  rx_dsp_inst.set_gain_cal_dB(settings.gain_cal);
+
+  //apply AGC speed
+  rx_dsp_inst.set_agc_speed(settings.agc_speed);
+  rx_dsp_inst.set_agc_look_ahead(settings.agc_look_ahead);
+
+  //apply Automatic Notch Filter
+  rx_dsp_inst.set_auto_notch(settings.enable_auto_notch);
+
+  //apply noise reduction
+  rx_dsp_inst.set_noise_reduction(settings.noise_reduction);
+
+  //apply noise blanker
+  rx_dsp_inst.set_noise_blanker(settings.noise_blanker);
+
+  //apply mode
+  rx_dsp_inst.set_mode(settings.mode, settings.bandwidth);
+
+  //apply volume
+  static const int16_t gain[] = {
+    0,   // 0 = 0/256 -infdB
+    16,  // 1 = 16/256 -24dB
+    23,  // 2 = 23/256 -21dB
+    32,  // 3 = 32/256 -18dB
+    45,  // 4 = 45/256 -15dB
+    64,  // 5 = 64/256 -12dB
+    90,  // 6 = 90/256  -9dB
+    128, // 7 = 128/256 -6dB
+    180, // 8 = 180/256 -3dB
+    256  // 9 = 256/256  0dB
+  };
+  gain_numerator = gain[settings.volume];
+
+  //apply deemphasis
+  rx_dsp_inst.set_deemphasis(settings.deemphasis);
+
+  //apply squelch
+  rx_dsp_inst.set_squelch(settings.squelch);
+
+  //apply swap iq
+  rx_dsp_inst.set_swap_iq(settings.swap_iq);
+
+  //apply iq imbalance correction
+  rx_dsp_inst.set_iq_correction(settings.iq_correction);
+
+  applied_settings_version = version;
 }
 
 void rx::get_spectrum(uint8_t spectrum[], uint8_t &dB10)
@@ -269,6 +268,10 @@ rx::rx(rx_settings & settings_to_apply, rx_status & status) : settings_to_apply(
 
     settings_to_apply.suspend = false;
     suspend = false;
+    settings_exchange.write(settings_to_apply);
+
+    //the run loop solves the iq imbalance correction between blocks
+    rx_dsp_inst.set_defer_iq_estimate(true);
 
     //Configure PIO to act as quadrature oscilator
     pio = pio0;
@@ -303,26 +306,23 @@ rx::rx(rx_settings & settings_to_apply, rx_status & status) : settings_to_apply(
     gpio_set_dir(3, GPIO_OUT);
     gpio_set_dir(4, GPIO_OUT);
     
-    // Configure DMA for ADC transfers
-    adc_dma_ping = dma_claim_unused_channel(true);
-    adc_dma_pong = dma_claim_unused_channel(true);
-    ping_cfg = dma_channel_get_default_config(adc_dma_ping);
-    pong_cfg = dma_channel_get_default_config(adc_dma_pong);
-
-    channel_config_set_transfer_data_size(&ping_cfg, DMA_SIZE_16);
-    channel_config_set_read_increment(&ping_cfg, false);
-    channel_config_set_write_increment(&ping_cfg, true);
-    channel_config_set_dreq(&ping_cfg, DREQ_ADC);// Pace transfers based on availability of ADC samples
-    channel_config_set_chain_to(&ping_cfg, adc_dma_pong);
-
-    channel_config_set_transfer_data_size(&pong_cfg, DMA_SIZE_16);
-    channel_config_set_read_increment(&pong_cfg, false);
-    channel_config_set_write_increment(&pong_cfg, true);
-    channel_config_set_dreq(&pong_cfg, DREQ_ADC);// Pace transfers based on availability of ADC samples
-    channel_config_set_chain_to(&pong_cfg, adc_dma_ping);
-
-    //settings semaphore
-    sem_init(&settings_semaphore, 1, 1);
+    // Configure DMA for ADC transfers, the control lists are filled when streaming starts
+    dma_ring_depth = 2;
+    adc_dma = dma_claim_unused_channel(true);
+    adc_cfg = dma_channel_get_default_config(adc_dma);
+    channel_config_set_transfer_data_size(&adc_cfg, DMA_SIZE_16);
+    channel_config_set_read_increment(&adc_cfg, false);
+    channel_config_set_write_increment(&adc_cfg, true);
+    channel_config_set_dreq(&adc_cfg, DREQ_ADC);// Pace transfers based on availability of ADC samples
+
+    //each completed adc block triggers the control channel, which writes the
+    //address of the next slot to the adc channel and triggers it
+    adc_control_dma = dma_claim_unused_channel(true);
+    adc_control_cfg = dma_channel_get_default_config(adc_control_dma);
+    channel_config_set_transfer_data_size(&adc_control_cfg, DMA_SIZE_32);
+    channel_config_set_read_increment(&adc_control_cfg, true);
+    channel_config_set_write_increment(&adc_control_cfg, false);
+    channel_config_set_chain_to(&adc_cfg, adc_control_dma);
 
     //audio output
     const uint AUDIO_PIN = 16;
@@ -336,29 +336,29 @@ rx::rx(rx_settings & settings_to_apply, rx_status & status) : settings_to_apply(
     pwm_init(audio_pwm_slice_num, &config, true);
 
     //configure DMA for audio transfers
-    pwm_dma_ping = dma_claim_unused_channel(true);
-    pwm_dma_pong = dma_claim_unused_channel(true);
-    audio_ping_cfg = dma_channel_get_default_config(pwm_dma_ping);
-    audio_pong_cfg = dma_channel_get_default_config(pwm_dma_pong);
-
-    channel_config_set_transfer_data_size(&audio_ping_cfg, DMA_SIZE_16);
-    channel_config_set_read_increment(&audio_ping_cfg, true);
-    channel_config_set_write_increment(&audio_ping_cfg, false);
-    channel_config_set_dreq(&audio_ping_cfg, DREQ_PWM_WRAP0 + audio_pwm_slice_num);
-
-    channel_config_set_transfer_data_size(&audio_pong_cfg, DMA_SIZE_16);
-    channel_config_set_read_increment(&audio_pong_cfg, true);
-    channel_config_set_write_increment(&audio_pong_cfg, false);
-    channel_config_set_dreq(&audio_pong_cfg, DREQ_PWM_WRAP0 + audio_pwm_slice_num);
+    pwm_dma = dma_claim_unused_channel(true);
+    audio_cfg = dma_channel_get_default_config(pwm_dma);
+    channel_config_set_transfer_data_size(&audio_cfg, DMA_SIZE_16);
+    channel_config_set_read_increment(&audio_cfg, true);
+    channel_config_set_write_increment(&audio_cfg, false);
+    channel_config_set_dreq(&audio_cfg, DREQ_PWM_WRAP0 + audio_pwm_slice_num);
+
+    //the adc control channel chains to the audio control channel, which
+    //starts the next slot of audio each time an adc block starts
+    pwm_control_dma = dma_claim_unused_channel(true);
+    audio_control_cfg = dma_channel_get_default_config(pwm_control_dma);
+    channel_config_set_transfer_data_size(&audio_control_cfg, DMA_SIZE_32);
+    channel_config_set_read_increment(&audio_control_cfg, true);
+    channel_config_set_write_increment(&audio_control_cfg, false);
+    channel_config_set_chain_to(&adc_control_cfg, pwm_control_dma);
 
     //configure DMA for audio transfers
     capture_dma = dma_claim_unused_channel(true);
-    capture_cfg = dma_channel_get_default_config(pwm_dma_ping);
+    capture_cfg = dma_channel_get_default_config(capture_dma);
     channel_config_set_transfer_data_size(&capture_cfg, DMA_SIZE_16);
     channel_config_set_read_increment(&capture_cfg, true);
     channel_config_set_write_increment(&capture_cfg, true);
 
-    dma_set_irq0_channel_mask_enabled((1u<<adc_dma_ping) | (1u<<adc_dma_pong), true);
     irq_set_exclusive_handler(DMA_IRQ_0, dma_handler);
     irq_set_enabled(DMA_IRQ_0, true);
 
@@ -419,6 +419,15 @@ static void on_usb_audio_tx_ready()
 
 
 uint16_t __not_in_flash_func(rx::process_block)(uint16_t adc_samples[], int16_t pwm_audio[])
+{
+  //process adc IQ samples to produce raw audio
+  int16_t usb_audio[adc_block_size/decimation_rate];
+  int16_t dual_watch_audio[adc_block_size/decimation_rate];
+  uint16_t num_samples = rx_dsp_inst.process_block(adc_samples, usb_audio, dual_watch?dual_watch_audio:nullptr);
+  return post_process(usb_audio, dual_watch_audio, num_samples, pwm_audio);
+}
+
+uint16_t __not_in_flash_func(rx::post_process)(int16_t usb_audio[], int16_t dual_watch_audio[], uint16_t num_samples, int16_t pwm_audio[])
 {
   //capture usb volume and mute settings
   critical_section_enter_blocking(&usb_volumute);
@@ -426,15 +435,18 @@ uint16_t __not_in_flash_func(rx::process_block)(uint16_t adc_samples[], int16_t
   bool safe_usb_mute = usb_mute;
   critical_section_exit(&usb_volumute);
 
-  //process adc IQ samples to produce raw audio
-  int16_t usb_audio[adc_block_size/decimation_rate];
-  uint16_t num_samples = rx_dsp_inst.process_block(adc_samples, usb_audio);
-  
   //post process audio for USB and PWM
   uint16_t odx = 0;
   for(uint16_t idx=0; idx<num_samples; ++idx)
   {
+    //dual watch audio is either mixed with the main channel, or replaces it on USB
+    if(dual_watch == 2)
+    {
+      const int32_t mixed = (int32_t)usb_audio[idx] + dual_watch_audio[idx];
+      usb_audio[idx] = std::max(std::min(mixed, (int32_t)INT16_MAX), (int32_t)-INT16_MAX);
+    }
     int16_t audio = usb_audio[idx];
+    if(dual_watch == 1) usb_audio[idx] = dual_watch_audio[idx];
 
     //digital volume control
     audio = ((int32_t)audio * gain_numerator) >> 8;
@@ -444,14 +456,12 @@ uint16_t __not_in_flash_func(rx::process_block)(uint16_t adc_samples[], int16_t
     audio = (uint16_t)audio/pwm_scale;
 
     //interpolate to PWM rate
-    static int16_t last_audio = 0;
     int32_t comb = audio - last_audio;
     last_audio = audio;
     for(uint8_t subsample = 0; subsample < interpolation_rate; ++subsample)
     {
-      static int32_t integrator = 0;
-      integrator += comb;
-      pwm_audio[odx++] = integrator >> 4;
+      pwm_integrator += comb;
+      pwm_audio[odx++] = pwm_integrator >> 4;
     }
 
     //usb audio volume is controlled from usb
@@ -464,9 +474,66 @@ uint16_t __not_in_flash_func(rx::process_block)(uint16_t adc_samples[], int16_t
 
   //add usb audio to ring buffer
   ring_buffer_push_ovr(&usb_ring_buffer, (uint8_t *)usb_audio, sizeof(int16_t) * num_samples); 
+  PROFILE_MARK(rx_dsp_inst.profiler, profile_post_process);
+  PROFILE_END(rx_dsp_inst.profiler);
   return num_samples * interpolation_rate;
 }
 
+void rx::update_load_shedding(uint32_t busy, bool missed_deadline)
+{
+  const uint8_t new_shed_level = load_shedder_inst.update(busy, block_time_us, missed_deadline);
+  if(new_shed_level != shed_level)
+  {
+    shed_level = new_shed_level;
+    rx_dsp_inst.set_load_shedding(shed_level);
+  }
+}
+
+#ifdef DUAL_CORE_DSP
+rx *rx::back_end_instance;
+
+void rx::start_back_end()
+{
+  //the lowest priority lets usb and the alarm pool interrupt a block
+  back_end_instance = this;
+  irq_set_exclusive_handler(DMA_IRQ_1, back_end_handler);
+  irq_set_priority(DMA_IRQ_1, PICO_LOWEST_IRQ_PRIORITY);
+  irq_set_enabled(DMA_IRQ_1, true);
+}
+
+void __not_in_flash_func(rx::back_end_handler)()
+{
+  //clear the doorbell before looking at the queue, so that a block queued
+  //meanwhile rings it again
+  dma_hw->intf1 = 0;
+  back_end_instance->process_queued_blocks();
+}
+
+void __not_in_flash_func(rx::process_queued_blocks)()
+{
+  s_iq_block *iq;
+  while((iq = iq_queue.front()))
+  {
+    const uint32_t start_time = time_us_32();
+    const uint32_t block = iq->block;
+    int16_t usb_audio[adc_block_size/decimation_rate];
+    int16_t dual_watch_audio[adc_block_size/decimation_rate];
+    uint16_t num_samples = rx_dsp_inst.process_back_end(iq->real, iq->imag, usb_audio, dual_watch?dual_watch_audio:nullptr);
+    iq_queue.pop();
+    post_process(usb_audio, dual_watch_audio, num_samples, audio_ring[adc_pwm_ring.slot(block)]);
+    back_end_busy_time = time_us_32()-start_time;
+    adc_pwm_ring.audio_done(block, adc_blocks_written);
+
+    //one block of latency is expected, any more and the deadline was missed
+    const bool missed_deadline = adc_blocks_written - block > 2;
+    update_load_shedding(back_end_busy_time, missed_deadline);
+
+    __dmb();
+    blocks_finished = blocks_finished + 1;
+  }
+}
+#endif
+
 void rx::run()
 {
     usb_audio_device_init();
@@ -484,29 +551,43 @@ void rx::run()
 
     while(true)
     {
-      if (settings_changed)
+      if (settings_pending())
       {
         apply_settings();
         pwm_ramp_up();
       }
 
       //read other adc channels when streaming is not running
-      uint32_t timeout = 15000;
+      //(about once a minute, whatever the block size)
+      uint32_t timeout = (uint32_t)30000u * 2048u / adc_block_size;
       read_batt_temp();
 
-      //supress audio output until first block has completed
-      audio_running = false;
+      //the audio ring plays silence until the first blocks have been processed
+      adc_pwm_ring.start(dma_ring_depth);
+      adc_blocks_written = 0;
+      for(uint8_t slot = 0; slot < adc_pwm_ring.get_depth(); ++slot)
+      {
+        for(uint16_t idx = 0; idx < pwm_block_size; ++idx) audio_ring[slot][idx] = INT16_MAX/pwm_scale;
+      }
+
       hw_clear_bits(&adc_hw->fcs, ADC_FCS_UNDER_BITS);
       hw_clear_bits(&adc_hw->fcs, ADC_FCS_OVER_BITS);
       adc_set_clkdiv(100 - 1);
       adc_fifo_setup(true, true, 1, false, false);
       adc_select_input(0);
       adc_set_round_robin(3);
-      dma_channel_configure(adc_dma_ping, &ping_cfg, ping_samples, &adc_hw->fifo, adc_block_size, false);
-      dma_channel_configure(adc_dma_pong, &pong_cfg, pong_samples, &adc_hw->fifo, adc_block_size, false);
-      dma_channel_set_irq0_enabled(adc_dma_ping, true);
-      dma_channel_set_irq0_enabled(adc_dma_pong, true);
-      dma_start_channel_mask(1u << adc_dma_ping);
+
+      //the control channels step through the slots, wrapping with a read ring
+      adc_pwm_ring.fill_control_list(adc_control_list, adc_ring, sizeof(adc_ring[0]));
+      adc_pwm_ring.fill_control_list(audio_control_list, audio_ring, sizeof(audio_ring[0]));
+      channel_config_set_ring(&adc_control_cfg, false, adc_pwm_ring.control_ring_bits());
+      channel_config_set_ring(&audio_control_cfg, false, adc_pwm_ring.control_ring_bits());
+      dma_channel_configure(adc_dma, &adc_cfg, adc_ring[0], &adc_hw->fifo, adc_block_size, false);
+      dma_channel_configure(pwm_dma, &audio_cfg, &pwm_hw->slice[audio_pwm_slice_num].cc, audio_ring[0], pwm_block_size, false);
+      dma_channel_configure(adc_control_dma, &adc_control_cfg, &dma_hw->ch[adc_dma].al2_write_addr_trig, adc_control_list.address, 1, false);
+      dma_channel_configure(pwm_control_dma, &audio_control_cfg, &dma_hw->ch[pwm_dma].al3_read_addr_trig, audio_control_list.address, 1, false);
+      dma_channel_set_irq0_enabled(adc_dma, true);
+      dma_start_channel_mask(1u << adc_control_dma);
       adc_run(true);
 
       while(true)
@@ -515,20 +596,26 @@ void rx::run()
           update_status();
 
           //periodically (or when requested) suspend streaming
-          if(timeout-- == 0 || suspend || settings_changed)
+          if(timeout-- == 0 || suspend || settings_pending())
           {
 
-            dma_channel_cleanup(adc_dma_ping);
-            dma_channel_cleanup(adc_dma_pong);
-            dma_channel_cleanup(pwm_dma_ping);
-            dma_channel_cleanup(pwm_dma_pong);
+            //stop the control channels first, so nothing is re-armed
+            dma_channel_cleanup(adc_control_dma);
+            dma_channel_cleanup(pwm_control_dma);
+            dma_channel_cleanup(adc_dma);
+            dma_channel_cleanup(pwm_dma);
 
             adc_run(false);
             adc_fifo_drain();
             adc_set_round_robin(0);
             adc_fifo_setup(false, false, 1, false, false);
 
-            if (settings_changed)
+#ifdef DUAL_CORE_DSP
+            //settings can't change while core 0 is part way through a block
+            while(blocks_finished != blocks_queued) tight_loop_contents();
+#endif
+
+            if (settings_pending())
             {
               // slowly ramp down PWM to avoid pops
               pwm_ramp_down();
@@ -537,13 +624,37 @@ void rx::run()
             break;
           }
 
-          //process adc data as each block completes
-          dma_channel_wait_for_finish_blocking(adc_dma_ping);
+          //process adc data in order as each block completes
+          while(!adc_pwm_ring.block_ready(adc_blocks_written)) tight_loop_contents();
+
+          const uint32_t block = adc_pwm_ring.next_block(adc_blocks_written);
+          const uint8_t slot = adc_pwm_ring.slot(block);
+#ifdef DUAL_CORE_DSP
+          //wait for core 0 if it is still busy with the last two blocks
+          s_iq_block *iq;
+          while(!(iq = iq_queue.back())) tight_loop_contents();
+          uint32_t start_time = time_us_32();
+          iq->block = block;
+          rx_dsp_inst.process_front_end(adc_ring[slot], iq->real, iq->imag);
+          iq_queue.push();
+          blocks_queued++;
+          dma_hw->intf1 = 1u << adc_dma;
+          busy_time = time_us_32()-start_time;
+          adc_pwm_ring.block_handed_off();
+#else
           uint32_t start_time = time_us_32();
-          num_ping_samples = process_block(ping_samples, ping_audio);
+          process_block(adc_ring[slot], audio_ring[slot]);
           busy_time = time_us_32()-start_time;
-          dma_channel_wait_for_finish_blocking(adc_dma_pong);
-          num_pong_samples = process_block(pong_samples, pong_audio);
+          adc_pwm_ring.block_done(adc_blocks_written);
+
+          //a block that finishes after the next one has arrived missed its
+          //deadline, shed features until processing keeps up again
+          const bool missed_deadline = adc_blocks_written - block > 1;
+          update_load_shedding(busy_time, missed_deadline);
+#endif
+
+          //the iq imbalance solve waits until the block is out of the way
+          rx_dsp_inst.update_iq_estimate();
       }
 
       //suspended state
@@ -7,7 +7,6 @@
 #include "nco.pio.h"
 
 #include "pico/stdlib.h"
-#include "pico/sem.h"
 #include "hardware/pio.h"
 #include "hardware/adc.h"
 #include "hardware/pwm.h"
@@ -15,12 +14,18 @@
 
 #include "rx_definitions.h"
 #include "rx_dsp.h"
+#include "dma_ring.h"
+#include "seqlock.h"
+#ifdef DUAL_CORE_DSP
+#include "spsc_queue.h"
+#endif
 
 struct rx_settings
 {
   double tuned_frequency_Hz;
   int step_Hz;
   uint8_t agc_speed;
+  bool agc_look_ahead;
   uint8_t mode;
   uint8_t volume;
   uint8_t squelch;
@@ -40,6 +45,12 @@ struct rx_settings
   bool swap_iq;
   bool iq_correction;
   bool enable_auto_notch;
+  uint8_t noise_reduction;
+  uint8_t noise_blanker;
+  uint8_t dual_watch; //0 = off, 1 = dual watch on usb audio, 2 = mixed with the main channel
+  double dual_watch_frequency_Hz;
+  uint8_t dma_ring_depth; //blocks of adc and audio buffering, 2 to max_dma_ring_depth
+  uint8_t load_shedding; //highest e_shed_level allowed, 0 = off
 };
 
 struct rx_status
@@ -50,6 +61,16 @@ struct rx_status
   uint16_t battery;
   s_filter_control filter_config;
   uint8_t usb_buf_level;
+  uint32_t noise_blanker_impulses;
+  uint32_t dma_overruns;
+  uint32_t dma_underruns;
+  uint32_t deadline_misses;
+  uint8_t shed_level;
+  int16_t dual_watch_bin; //relative to the tuned frequency, 0 when off
+#ifdef DSP_PROFILE
+  s_profile_stats profile[num_profile_stages]; //cycles
+  uint32_t cycles_per_us;
+#endif
 };
 
 class rx
@@ -65,12 +86,22 @@ class rx
   double tuned_frequency_Hz;
   double nco_frequency_Hz;
   double offset_frequency_Hz;
-  semaphore_t settings_semaphore;
-  bool settings_changed;
   bool suspend;
   uint16_t temp;
   uint16_t battery;
 
+  //Settings and status are exchanged between the cores without locks.
+  //Core 0 publishes a new copy of the settings, and counts the changes that
+  //need to be applied. Core 1 publishes a new copy of the status once per
+  //block. Neither core ever waits for the other.
+  seqlock<rx_settings> settings_exchange;
+  seqlock<rx_status> status_exchange;
+  volatile uint32_t settings_version = 0;
+  uint32_t applied_settings_version = 0;
+  bool settings_pending() const { return settings_version != applied_settings_version; }
+  rx_settings settings;       //core 1's copy
+  rx_status current_status;   //built by core 1
+
   // Choose which PIO instance to use (there are two instances)
   PIO pio;
   uint offset;
@@ -80,50 +111,103 @@ class rx
   static int capture_dma;
   static dma_channel_config capture_cfg;
 
-  //buffers and dma for adc
-  static int adc_dma_ping;
-  static int adc_dma_pong;
-  static dma_channel_config ping_cfg;
-  static dma_channel_config pong_cfg;
-  static uint16_t ping_samples[adc_block_size];
-  static uint16_t pong_samples[adc_block_size];
-  static uint16_t num_ping_samples;
-  static uint16_t num_pong_samples;
-
-  //buffers and dma for PWM audio output
+  //buffers and dma for adc and PWM audio, a ring of blocks re-armed by
+  //control channels (see dma_ring.h), one block of audio for each adc block
+  static const uint16_t pwm_block_size = adc_block_size*interpolation_rate/decimation_rate;
+  uint8_t dma_ring_depth;
+  dma_ring adc_pwm_ring;
+  static int adc_dma;
+  static int adc_control_dma;
+  static dma_channel_config adc_cfg;
+  static dma_channel_config adc_control_cfg;
+  static uint16_t adc_ring[max_dma_ring_depth][adc_block_size];
+  static s_dma_control_list adc_control_list;
+  static volatile uint32_t adc_blocks_written;
   static int audio_pwm_slice_num;
-  static int pwm_dma_ping;
-  static int pwm_dma_pong;
-  static dma_channel_config audio_ping_cfg;
-  static dma_channel_config audio_pong_cfg;
-  static int16_t ping_audio[adc_block_size];
-  static int16_t pong_audio[adc_block_size];
-  static bool audio_running;
+  static int pwm_dma;
+  static int pwm_control_dma;
+  static dma_channel_config audio_cfg;
+  static dma_channel_config audio_control_cfg;
+  static int16_t audio_ring[max_dma_ring_depth][pwm_block_size];
+  static s_dma_control_list audio_control_list;
   static void dma_handler();
+
   uint32_t pwm_max;
   uint32_t pwm_scale;
   uint16_t process_block(uint16_t adc_samples[], int16_t pwm_audio[]);
+  uint16_t post_process(int16_t usb_audio[], int16_t dual_watch_audio[], uint16_t num_samples, int16_t pwm_audio[]);
+  void update_load_shedding(uint32_t busy, bool missed_deadline);
+
+#ifdef DUAL_CORE_DSP
+  //Two stage pipeline, with one block of latency. Core 1 runs the front end
+  //of each block and queues the decimated IQ, then rings a doorbell (a
+  //forced DMA_IRQ_1, only enabled on core 0). Core 0 runs the rest of the
+  //block in the interrupt, in between UI tasks.
+  static_assert(max_dma_ring_depth >= 4, "DUAL_CORE_DSP needs DMA_RING_DEPTH 4");
+  struct s_iq_block
+  {
+    uint32_t block;
+    int16_t real[rx_dsp::iq_block_size];
+    int16_t imag[rx_dsp::iq_block_size];
+  };
+  spsc_queue<s_iq_block, 2> iq_queue;
+  uint32_t blocks_queued = 0;           //written by core 1
+  volatile uint32_t blocks_finished = 0; //written by core 0
+  uint32_t back_end_busy_time = 0;
+  static rx *back_end_instance;
+  static void back_end_handler();
+  void process_queued_blocks();
+#endif
+
+  //interpolation of the audio to the PWM rate
+  int16_t last_audio = 0;
+  int32_t pwm_integrator = 0;
   
   //store busy time for performance monitoring
   uint32_t busy_time;
 
+  //usb buffer level, averaged for the status page
+  uint16_t usb_buf_level_avg = 0;
+
+  //give up features when processing can't keep up
+  static const uint32_t block_time_us = (uint32_t)adc_block_size * 1000000u / adc_sample_rate;
+  load_shedder load_shedder_inst;
+  uint8_t shed_level = shed_none;
+
   alarm_pool_t *pool = NULL;
 
+  //dc and iq imbalance estimates for each band filter, kept in RAM
+  static const uint8_t num_bands = 8;
+  s_iq_dc_estimate band_estimates[num_bands];
+  bool band_estimate_valid[num_bands] = {};
+  uint8_t current_band = num_bands; //none yet
+  bool band_estimates_swap_iq = false;
+
   //volume control
   int16_t gain_numerator=0;
 
+  //dual watch audio routing
+  uint8_t dual_watch=0;
+
   public:
   rx(rx_settings & settings_to_apply, rx_status & status);
   void apply_settings();
   void run();
   void get_spectrum(uint8_t spectrum[], uint8_t &dB10);
   void set_alarm_pool(alarm_pool_t *p);
+#ifdef DUAL_CORE_DSP
+  //called from core 0, to run the back end of the pipeline there
+  void start_back_end();
+#endif
   rx_settings &settings_to_apply;
   rx_status &status;
   rx_dsp rx_dsp_inst;
   void read_batt_temp();
-  void access(bool settings_changed);
-  void release();
+  //called from core 0, publish settings_to_apply to the receiver, and apply
+  //them if they have changed
+  void publish_settings(bool settings_changed);
+  //called from core 0, update status with the latest from the receiver
+  void refresh_status();
 };
 
 #endif
@@ -6,7 +6,6 @@ const uint32_t adc_sample_rate = 480e3;
 const uint32_t audio_sample_rate = adc_sample_rate/2;
 const uint8_t  adc_bits = 12u;
 const uint16_t adc_max=1<<(adc_bits-1);
-const uint16_t adc_block_size = 2048u;
 const uint8_t  AM = 0u;
 const uint8_t  AMSYNC = 1u;
 const uint8_t  LSB = 2u;
@@ -16,6 +15,27 @@ const uint8_t  CW = 5u;
 
 const uint16_t decimation_rate = 32u; //cic decimation
 const uint16_t cic_decimation_rate = decimation_rate/2u;
+
+//fft filter size is 2^FFT_ORDER points, 8 to 10 (256 to 1024)
+#ifndef FFT_ORDER
+#define FFT_ORDER 8
+#endif
+const uint8_t  fft_order = FFT_ORDER;
+const uint16_t fft_size = 1u << fft_order;
+
+//each block of ADC samples provides half an fft of decimated samples
+const uint16_t adc_block_size = (fft_size/2u) * cic_decimation_rate;
+
+//ADC and PWM DMA use a ring of up to DMA_RING_DEPTH blocks. More blocks
+//tolerate longer stalls in processing, at the cost of RAM and latency.
+#ifndef DMA_RING_DEPTH
+#define DMA_RING_DEPTH 4
+#endif
+const uint8_t max_dma_ring_depth = DMA_RING_DEPTH;
+
+//the spectrum display is always 256 points, each made of one or more fft bins
+const uint16_t spectrum_bin_size = fft_size/256u;
+
 const uint16_t interpolation_rate = decimation_rate/2u;
 const uint16_t extra_bits = 1u;
 const uint8_t  cic_order = 4u;
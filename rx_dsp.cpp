@@ -3,24 +3,21 @@
 #include "fft_filter.h"
 #include "utils.h"
 #include "pico/stdlib.h"
+#include "hardware/sync.h"
 #include "cic_corrections.h"
 
 #include <math.h>
 #include <cstdio>
+#include <cstring>
 #include <algorithm>
 
 static const int16_t deemph_taps[2][3] = {{14430, 14430, -3909}, {10571, 10571, -11626}};
-int16_t __not_in_flash_func(rx_dsp :: apply_deemphasis)(int16_t x)
+inline __attribute__((always_inline)) int16_t rx_dsp :: apply_deemphasis(int16_t x, const int16_t taps[], s_rx_channel &channel)
 {
-  if(deemphasis == 0)
-    return x;
+  int16_t &x1 = channel.deemphasis_x1;
+  int16_t &y1 = channel.deemphasis_y1;
 
-  static int16_t x1 = 0;
-  static int16_t y1 = 0;
-
-  size_t i = deemphasis - 1;
-
-  int16_t y = ((x * deemph_taps[i][0]) >> 15) + ((x1 * deemph_taps[i][1]) >> 15) - ((y1 * deemph_taps[0][2]) >> 15);
+  int16_t y = ((x * taps[0]) >> 15) + ((x1 * taps[1]) >> 15) - ((y1 * deemph_taps[0][2]) >> 15);
   x1 = x;
   y1 = y;
   return y;
@@ -46,160 +43,248 @@ void inline rx_dsp :: iq_imbalance_correction(int16_t &i, int16_t &q)
 {
     if (iq_correction)
     {
-      static uint16_t index = 0;
-      static int32_t theta1 = 0;
-      static int32_t theta2 = 0;
-      static int32_t theta3 = 0;
-
-      theta1 += ((i < 0) ? -q : q);
-      theta2 += ((i < 0) ? -i : i);
-      theta3 += ((q < 0) ? -q : q);
-
-      static int32_t c1 = 0;
-      static int32_t c2 = 0;
-      if (++index == 512)
-      {             
-        static int64_t theta1_filtered = 0;
-        static int64_t theta2_filtered = 0;
-        static int64_t theta3_filtered = 0;
-        theta1_filtered = theta1_filtered - (theta1_filtered >> 5) + (-theta1 >> 5);
-        theta2_filtered = theta2_filtered - (theta2_filtered >> 5) + (theta2 >> 5);
-        theta3_filtered = theta3_filtered - (theta3_filtered >> 5) + (theta3 >> 5);
-
-        //try to constrain square to less than 32 bits.
-        //Assue that i/q used full int16_t range.
-        //Accumulating 512 samples adds 9 bits of growth, so remove 18 after square.
-        const int64_t theta1_squared = (theta1_filtered * theta1_filtered) >> 18; 
-        const int64_t theta2_squared = (theta2_filtered * theta2_filtered) >> 18;
-        const int64_t theta3_squared = (theta3_filtered * theta3_filtered) >> 18;
-
-        c1 = (theta1_filtered << 15)/theta2_filtered;
-        c2 = intsqrt(((theta3_squared - theta1_squared) << 30)/theta2_squared);
-
-        theta1 = 0;
-        theta2 = 0;
-        theta3 = 0;
-        index = 0;
+      //under heavy load, keep applying the last estimate
+      if (!freeze_iq_estimation)
+      {
+        theta1 += ((i < 0) ? -q : q);
+        theta2 += ((i < 0) ? -i : i);
+        theta3 += ((q < 0) ? -q : q);
+
+        //hand each set of 512 samples to update_iq_estimate
+        if (++iq_index == 512)
+        {             
+          theta1_total = theta1;
+          theta2_total = theta2;
+          theta3_total = theta3;
+          iq_totals_ready = true;
+          theta1 = 0;
+          theta2 = 0;
+          theta3 = 0;
+          iq_index = 0;
+        }
       }
 
-      q += ((int32_t)i * c1) >> 15;
-      i = ((int32_t)i * c2) >> 15;
+      q += ((int32_t)i * iq_c1) >> 15;
+      i = ((int32_t)i * iq_c2) >> 15;
     }
 }
 
-uint16_t __not_in_flash_func(rx_dsp :: process_block)(uint16_t samples[], int16_t audio_samples[])
+//The divisions and square root are kept out of the sample loop. The sets of
+//512 samples end on a block boundary, so solving any time before the next
+//block gives the same coefficients as solving straight away.
+static_assert(512 % rx_dsp::iq_block_size == 0, "iq imbalance sets must end on a block boundary");
+void __not_in_flash_func(rx_dsp :: update_iq_estimate)()
 {
+    if (!iq_totals_ready) return;
+    iq_totals_ready = false;
+
+    theta1_filtered = theta1_filtered - (theta1_filtered >> 5) + (-theta1_total >> 5);
+    theta2_filtered = theta2_filtered - (theta2_filtered >> 5) + (theta2_total >> 5);
+    theta3_filtered = theta3_filtered - (theta3_filtered >> 5) + (theta3_total >> 5);
+
+    //try to constrain square to less than 32 bits.
+    //Assue that i/q used full int16_t range.
+    //Accumulating 512 samples adds 9 bits of growth, so remove 18 after square.
+    const int64_t theta1_squared = (theta1_filtered * theta1_filtered) >> 18; 
+    const int64_t theta2_squared = (theta2_filtered * theta2_filtered) >> 18;
+    const int64_t theta3_squared = (theta3_filtered * theta3_filtered) >> 18;
+
+    iq_c1 = (theta1_filtered << 15)/theta2_filtered;
+    iq_c2 = intsqrt(((theta3_squared - theta1_squared) << 30)/theta2_squared);
+}
 
-  uint16_t decimated_index = 0;
-  int32_t magnitude_sum = 0;
-  int16_t real[adc_block_size/cic_decimation_rate];
-  int16_t imag[adc_block_size/cic_decimation_rate];
+uint16_t __not_in_flash_func(rx_dsp :: process_block)(uint16_t samples[], int16_t audio_samples[], int16_t dual_watch_samples[])
+{
+  process_front_end(samples, block_real, block_imag);
+  return process_back_end(block_real, block_imag, audio_samples, dual_watch_samples);
+}
 
-  for(uint16_t idx=0; idx<adc_block_size; idx++)
-  {
-      //convert to signed representation
-      const int16_t raw_sample = samples[idx];
+void __not_in_flash_func(rx_dsp :: process_front_end)(uint16_t samples[], int16_t real[], int16_t imag[])
+{
+  PROFILE_START(profiler);
 
-      //work out which samples are i and q
-      int16_t i = ((idx&1)^1^swap_iq)*raw_sample;//even samples contain i data
-      int16_t q = ((idx&1)^swap_iq)*raw_sample;//odd samples contain q data
+  //remove impulses before the decimator smears them out
+  noise_blanker_inst.process_block(samples);
+  PROFILE_MARK(profiler, profile_noise_blanker);
 
-      //reduce sample rate by a factor of 16
-      if(decimate(i, q))
-      {
+  //separate i and q, and reduce sample rate by a factor of 16
+  cic_decimator_inst.process_block(samples, real, imag, swap_iq);
+  PROFILE_MARK(profiler, profile_cic);
 
-        static uint32_t iq_count = 0;
-        static int32_t i_accumulator = 0;
-        static int32_t q_accumulator = 0;
-        static int16_t i_avg = 0;
-        static int16_t q_avg = 0;
-        i_accumulator += i;
-        q_accumulator += q;
-        if (++iq_count == 2048) //power of 2 avoids division
-        {
-          i_avg = i_accumulator / 2048;
-          q_avg = q_accumulator / 2048;
-          i_accumulator = 0;
-          q_accumulator = 0;
-          iq_count = 0;
-        }
-        i -= i_avg;
-        q -= q_avg;
-
-        iq_imbalance_correction(i, q);
-
-        //Apply frequency shift (move tuned frequency to DC)
-        frequency_shift(i, q);
-
-        #ifdef MEASURE_DC_BIAS 
-        static int64_t bias_measurement = 0; 
-        static int32_t num_bias_measurements = 0; 
-        if(num_bias_measurements == 100000) { 
-          printf("DC BIAS x 100 %lli\n", bias_measurement/1000); 
-          num_bias_measurements = 0; 
-          bias_measurement = 0; 
-        } 
-        else { 
-          num_bias_measurements++; 
-          bias_measurement += i; 
-        } 
-        #endif 
-
-        real[decimated_index] = i;
-        imag[decimated_index] = q;
-        ++decimated_index;
+  //When the fft filter rotates the spectrum, only the part of the offset
+  //smaller than one bin is left to remove in the time domain. This is
+  //done after the filter at the lower sample rate, and not at all if
+  //the offset is a whole number of bins.
+  const bool shift_before_filter = !filter_control.rotate_bins;
+
+  for(uint16_t idx=0; idx<adc_block_size/cic_decimation_rate; idx++)
+  {
+      int16_t i = real[idx];
+      int16_t q = imag[idx];
+
+      i_accumulator += i;
+      q_accumulator += q;
+      if (++iq_count == 2048) //power of 2 avoids division
+      {
+        i_avg = i_accumulator / 2048;
+        q_avg = q_accumulator / 2048;
+        i_accumulator = 0;
+        q_accumulator = 0;
+        iq_count = 0;
       }
+      i -= i_avg;
+      q -= q_avg;
+
+      iq_imbalance_correction(i, q);
+
+      //Apply frequency shift (move tuned frequency to DC)
+      //unless the fft filter is doing it
+      if(shift_before_filter) frequency_shift(i, q, main_channel);
+
+      #ifdef MEASURE_DC_BIAS 
+      static int64_t bias_measurement = 0; 
+      static int32_t num_bias_measurements = 0; 
+      if(num_bias_measurements == 100000) { 
+        printf("DC BIAS x 100 %lli\n", bias_measurement/1000); 
+        num_bias_measurements = 0; 
+        bias_measurement = 0; 
+      } 
+      else { 
+        num_bias_measurements++; 
+        bias_measurement += i; 
+      } 
+      #endif 
+
+      real[idx] = i;
+      imag[idx] = q;
   }
 
+  if(!defer_iq_estimate) update_iq_estimate();
+  PROFILE_MARK(profiler, profile_front_end);
+}
+
+uint16_t __not_in_flash_func(rx_dsp :: process_back_end)(int16_t real[], int16_t imag[], int16_t audio_samples[], int16_t dual_watch_samples[])
+{
+  const bool shift_after_filter = filter_control.rotate_bins && main_channel.frequency != 0;
+
   //fft filter decimates a further 2x
-  //if the capture buffer isn't in use, fill it
-  filter_control.capture = sem_try_acquire(&spectrum_semaphore);
-  capture_filter_control = filter_control;
-  fft_filter_inst.process_sample(real, imag, filter_control, capture);
-  if(filter_control.capture) sem_release(&spectrum_semaphore);
+  //the running average continues from the front buffer into the back
+  //buffer, which is published once the block is complete
+  filter_control.capture = !skip_capture;
+  const uint32_t published = captures_published;
+  const uint8_t back = (published + 1) & 1;
+  if(filter_control.capture)
+  {
+    memcpy(capture[back], capture[published & 1], sizeof(capture[back]));
+    capture_filter_control[back] = filter_control;
+  }
+  fft_filter_inst.process_sample(real, imag, filter_control, capture[back]);
+  if(filter_control.capture)
+  {
+    __dmb();
+    captures_published = published + 1;
+  }
+  PROFILE_MARK(profiler, profile_fft_filter);
+
+  demodulate_block(real, imag, audio_samples, shift_after_filter, main_channel);
+  PROFILE_MARK(profiler, profile_demodulate);
+
+  //the dual watch channel is filtered from the same forward fft
+  if(dual_watch_samples)
+  {
+    if(dual_watch_active)
+    {
+      fft_filter_inst.process_sub_channel(dual_watch_real, dual_watch_imag, dual_watch_filter_control, dual_watch_rotation);
+      demodulate_block(dual_watch_real, dual_watch_imag, dual_watch_samples, dual_watch_channel.frequency != 0, dual_watch_channel);
+    }
+    else
+    {
+      for(uint16_t idx=0; idx<adc_block_size/decimation_rate; idx++) dual_watch_samples[idx] = 0;
+    }
+  }
+  PROFILE_MARK(profiler, profile_dual_watch);
+
+  return adc_block_size/decimation_rate;
+}
 
+//One loop for each demodulator, with or without de-emphasis, so that the
+//loop has no branches on the mode. Returns the sum of the sample magnitudes.
+template <uint8_t demod_mode, bool deemph>
+inline __attribute__((always_inline)) int32_t rx_dsp :: demodulate_samples(const int16_t real[], const int16_t imag[], int16_t audio_samples[], bool shift, s_rx_channel &channel)
+{
+  const int16_t *taps = deemph_taps[deemph ? deemphasis - 1 : 0];
+  int32_t magnitude_sum = 0;
   for(uint16_t idx=0; idx<adc_block_size/decimation_rate; idx++)
   {
     int16_t i = real[idx];
     int16_t q = imag[idx];
 
+    //remove residual frequency offset
+    if(shift) frequency_shift(i, q, channel);
+
     //Measure amplitude (for signal strength indicator)
     int32_t amplitude = rectangular_2_magnitude(i, q);
     magnitude_sum += amplitude;
 
     //Demodulate to give audio sample
-    int32_t audio = demodulate(i, q);
+    int32_t audio = demodulate<demod_mode>(i, q, channel);
 
     //De-emphasis
-    audio = apply_deemphasis(audio);
-
-    //Automatic gain control scales signal to use full 16 bit range
-    //e.g. -32767 to 32767
-    audio = automatic_gain_control(audio);
-
-    //squelch
-    if(signal_amplitude < squelch_threshold) {
-      audio = 0;
-    }
+    if(deemph) audio = apply_deemphasis(audio, taps, channel);
 
     //output raw audio
     audio_samples[idx] = audio;
   }
+  return magnitude_sum;
+}
 
-  //average over the number of samples
-  signal_amplitude = (magnitude_sum * decimation_rate)/adc_block_size;
+void __not_in_flash_func(rx_dsp :: demodulate_block)(int16_t real[], int16_t imag[], int16_t audio_samples[], bool shift, s_rx_channel &channel)
+{
+  //choose the demodulator once for the whole block
+  const bool deemph = deemphasis != 0;
+  int32_t magnitude_sum;
+  switch(mode)
+  {
+    case AM:
+      magnitude_sum = deemph ? demodulate_samples<AM, true>(real, imag, audio_samples, shift, channel) :
+                               demodulate_samples<AM, false>(real, imag, audio_samples, shift, channel);
+      break;
+    case AMSYNC:
+      magnitude_sum = deemph ? demodulate_samples<AMSYNC, true>(real, imag, audio_samples, shift, channel) :
+                               demodulate_samples<AMSYNC, false>(real, imag, audio_samples, shift, channel);
+      break;
+    case FM:
+      magnitude_sum = deemph ? demodulate_samples<FM, true>(real, imag, audio_samples, shift, channel) :
+                               demodulate_samples<FM, false>(real, imag, audio_samples, shift, channel);
+      break;
+    case LSB:
+    case USB:
+      magnitude_sum = deemph ? demodulate_samples<USB, true>(real, imag, audio_samples, shift, channel) :
+                               demodulate_samples<USB, false>(real, imag, audio_samples, shift, channel);
+      break;
+    default:
+      magnitude_sum = deemph ? demodulate_samples<CW, true>(real, imag, audio_samples, shift, channel) :
+                               demodulate_samples<CW, false>(real, imag, audio_samples, shift, channel);
+      break;
+  }
 
-  return adc_block_size/decimation_rate;
+  //Automatic gain control scales signal to use full 16 bit range
+  //e.g. -32767 to 32767, and mutes the block if it is squelched
+  const bool squelched = channel.signal_amplitude < squelch_threshold;
+  automatic_gain_control(audio_samples, adc_block_size/decimation_rate, squelched, channel);
+
+  //average over the number of samples
+  channel.signal_amplitude = (magnitude_sum * decimation_rate)/adc_block_size;
 }
 
-void __not_in_flash_func(rx_dsp :: frequency_shift)(int16_t &i, int16_t &q)
+void __not_in_flash_func(rx_dsp :: frequency_shift)(int16_t &i, int16_t &q, s_rx_channel &channel)
 {
     //Apply frequency shift (move tuned frequency to DC)         
-    const uint16_t scaled_phase = (phase >> 21);
+    const uint16_t scaled_phase = (channel.phase >> 21);
     const int16_t rotation_i =  sin_table[(scaled_phase+512u) & 0x7ff]; //32 - 21 = 11MSBs
     const int16_t rotation_q = -sin_table[scaled_phase];
 
-    phase += frequency;
+    channel.phase += channel.frequency;
     //truncating fractional bits introduces bias, but it is more efficient to remove it after decimation
     int32_t bias = (1<<14);
     const int16_t i_shifted = (((int32_t)i * rotation_i) - ((int32_t)q * rotation_q) + bias) >> 15;
@@ -209,65 +294,22 @@ void __not_in_flash_func(rx_dsp :: frequency_shift)(int16_t &i, int16_t &q)
     q = q_shifted;
 }
 
-bool __not_in_flash_func(rx_dsp :: decimate)(int16_t &i, int16_t &q)
-{
-
-      //CIC decimation filter
-      //implement integrator stages
-      integratori1 += i;
-      integratorq1 += q;
-      integratori2 += integratori1;
-      integratorq2 += integratorq1;
-      integratori3 += integratori2;
-      integratorq3 += integratorq2;
-      integratori4 += integratori3;
-      integratorq4 += integratorq3;
-
-      decimate_count++;
-      if(decimate_count >= cic_decimation_rate)
-      {
-        decimate_count = 0;
-
-        //implement comb stages
-        const int32_t combi1 = integratori4-delayi0;
-        const int32_t combq1 = integratorq4-delayq0;
-        const int32_t combi2 = combi1-delayi1;
-        const int32_t combq2 = combq1-delayq1;
-        const int32_t combi3 = combi2-delayi2;
-        const int32_t combq3 = combq2-delayq2;
-        const int32_t combi4 = combi3-delayi3;
-        const int32_t combq4 = combq3-delayq3;
-        delayi0 = integratori4;
-        delayq0 = integratorq4;
-        delayi1 = combi1;
-        delayq1 = combq1;
-        delayi2 = combi2;
-        delayq2 = combq2;
-        delayi3 = combi3;
-        delayq3 = combq3;
-
-        //remove bit growth, but keep some extra bits since noise floor is now lower
-        i = combi4>>(cic_bit_growth-extra_bits);
-        q = combq4>>(cic_bit_growth-extra_bits);
-
-        return true;
-      }
-
-      return false;
-}
-
 #define AMSYNC_ALPHA (3398)
 #define AMSYNC_BETA (1898)
 #define AMSYNC_F_MIN (-218)
 #define AMSYNC_F_MAX (218)
 #define AMSYNC_FIX_MAX (32767)
 
-int16_t __not_in_flash_func(rx_dsp :: demodulate)(int16_t i, int16_t q)
+//the mode is a template parameter, so each block loop gets just its own
+//demodulator (LSB and USB share one)
+template <uint8_t demod_mode>
+inline __attribute__((always_inline)) int16_t rx_dsp :: demodulate(int16_t i, int16_t q, s_rx_channel &channel)
 {
-   static int32_t phi_locked = 0;
-   static int32_t freq_locked = 0;
+   int32_t &audio_dc = channel.audio_dc;
+   int32_t &phi_locked = channel.phi_locked;
+   int32_t &freq_locked = channel.freq_locked;
 
-    if(mode == AM)
+    if constexpr(demod_mode == AM)
     {
         int16_t amplitude = rectangular_2_magnitude(i, q);
         //measure DC using first order IIR low-pass filter
@@ -275,7 +317,7 @@ int16_t __not_in_flash_func(rx_dsp :: demodulate)(int16_t i, int16_t q)
         //subtract DC component
         return amplitude - (audio_dc >> 5);
     }
-    else if(mode == AMSYNC)
+    else if constexpr(demod_mode == AMSYNC)
     {
       size_t idx;
 
@@ -328,20 +370,22 @@ int16_t __not_in_flash_func(rx_dsp :: demodulate)(int16_t i, int16_t q)
       // subtract DC component
       return synced_q - (audio_dc >> 5);
     }
-    else if(mode == FM)
+    else if constexpr(demod_mode == FM)
     {
-        int16_t phase = rectangular_2_phase(i, q);
-        int16_t frequency = phase - last_phase;
-        last_phase = phase;
+        //polar discriminator, the phase change since the last sample
+        const int16_t frequency = phase_difference(i, q, channel.last_i, channel.last_q);
+        channel.last_i = i;
+        channel.last_q = q;
 
         return frequency;
     }
-    else if(mode == LSB || mode == USB)
+    else if constexpr(demod_mode == LSB || demod_mode == USB)
     {
         return i;
     }
-    else //if(mode==cw)
+    else //if(demod_mode==cw)
     {
+      int16_t &cw_sidetone_phase = channel.cw_sidetone_phase;
       cw_sidetone_phase += cw_sidetone_frequency_Hz * 2048 * decimation_rate / adc_sample_rate;
       const int16_t rotation_i =  sin_table[(cw_sidetone_phase + 512u) & 0x7ffu];
       const int16_t rotation_q = -sin_table[cw_sidetone_phase & 0x7ffu];
@@ -349,109 +393,148 @@ int16_t __not_in_flash_func(rx_dsp :: demodulate)(int16_t i, int16_t q)
     }
 }
 
-int16_t __not_in_flash_func(rx_dsp::automatic_gain_control)(int16_t audio_in)
+//setpoint/magnitude with 8 fraction bits, for magnitudes 1 to 32767. The
+//magnitude is normalised to 128-255 to look up its reciprocal, so there is
+//no division.
+static inline int32_t agc_gain(int32_t setpoint, int32_t magnitude)
 {
-    //Use a leaky max hold to estimate audio power
-    //             _
-    //            | |
-    //            | |
-    //    audio __| |_____________________
-    //            | |
-    //            |_|
-    //
-    //                _____________
-    //               /             \_
-    //    max_hold  /                \_
-    //           _ /                   \_
-    //              ^                ^
-    //            attack             |
-    //                <---hang--->   |
-    //                             decay
-
-    // Attack is fast so that AGC reacts fast to increases in power
-    // Hang time and decay are relatively slow to prevent rapid gain changes
+  const uint8_t msb = 31 - __builtin_clz(magnitude);
+  const uint32_t mantissa = msb >= 7 ? magnitude >> (msb - 7) : magnitude << (7 - msb);
+  return (setpoint * reciprocal_table.value[mantissa - 128u]) >> (msb + 7);
+}
 
+//The envelope is tracked for every sample, but the gain is only worked out
+//at the end of each sub-block of 2^agc_sub_block_bits samples, and ramps
+//there from the gain at the end of the last sub-block. With look ahead, the
+//ramp already heads for the gain needed by the next sub-block, so the gain
+//is down before a sudden peak arrives rather than overshooting.
+void __not_in_flash_func(rx_dsp::automatic_gain_control)(int16_t audio[], uint16_t num_samples, bool squelched, s_rx_channel &channel)
+{
+    //Use a leaky max hold to estimate audio power
     static const uint8_t extra_bits = 16;
-    int32_t audio = audio_in;
-    const int32_t audio_scaled = audio << extra_bits;
-    if(audio_scaled > max_hold)
-    {
-      //attack
-      max_hold += (audio_scaled - max_hold) >> attack_factor;
-      hang_timer = hang_time;
-    }
-    else if(hang_timer)
+    int32_t &max_hold = channel.max_hold;
+    uint16_t &hang_timer = channel.hang_timer;
+    int32_t &gain = channel.gain;
+    const int32_t limit = INT16_MAX; //hard limit
+    const int32_t setpoint = limit/2; //about half full scale
+
+    //envelope at the end of each sub-block
+    const uint16_t num_sub_blocks = num_samples >> agc_sub_block_bits;
+    int16_t magnitude[max_agc_sub_blocks];
+    for(uint16_t sub_block = 0; sub_block < num_sub_blocks; ++sub_block)
     {
-      //hang
-      hang_timer--;
-    }
-    else if(max_hold > 0)
-    {
-      //decay
-      max_hold -= max_hold>>decay_factor; 
+      const int16_t *sub_block_audio = &audio[sub_block << agc_sub_block_bits];
+      for(uint16_t idx = 0; idx < agc_sub_block_size; ++idx)
+      {
+        const int32_t audio_scaled = (int32_t)sub_block_audio[idx] << extra_bits;
+        if(audio_scaled > max_hold)
+        {
+          //attack
+          max_hold += (audio_scaled - max_hold) >> attack_factor;
+          hang_timer = hang_time;
+        }
+        else if(hang_timer)
+        {
+          //hang
+          hang_timer--;
+        }
+        else if(max_hold > 0)
+        {
+          //decay
+          max_hold -= max_hold>>decay_factor;
+        }
+      }
+      magnitude[sub_block] = max_hold >> extra_bits;
     }
 
-    //calculate gain needed to amplify to full scale
-    const int16_t magnitude = max_hold >> extra_bits;
-    const int16_t limit = INT16_MAX; //hard limit
-    const int16_t setpoint = limit/2; //about half full scale
-
-    //apply gain
-    if(magnitude > 0)
+    for(uint16_t sub_block = 0; sub_block < num_sub_blocks; ++sub_block)
     {
-      if(manual_gain_control)
+      int16_t envelope = magnitude[sub_block];
+      if(agc_look_ahead && sub_block + 1 < num_sub_blocks) envelope = std::max(envelope, magnitude[sub_block + 1]);
+
+      //calculate gain needed to amplify to full scale (8 fraction bits)
+      int32_t target = 1 << 8;
+      if(envelope > 0)
       {
-        gain = manual_gain;
+        target = manual_gain_control ? manual_gain << 8 : agc_gain(setpoint, envelope);
+        if(target < (1 << 8)) target = 1 << 8;
       }
-      else
+      int16_t *sub_block_audio = &audio[sub_block << agc_sub_block_bits];
+      if(squelched)
       {
-        gain = setpoint/magnitude;
+        for(uint16_t idx = 0; idx < agc_sub_block_size; ++idx) sub_block_audio[idx] = 0;
+        gain = target;
+        continue;
       }
-      if(gain < 1) gain = 1;
-      audio *= gain;
-    }
 
-    //soft clip (compress)
-    if (audio > setpoint)  audio =  setpoint + ((audio-setpoint)>>1);
-    if (audio < -setpoint) audio = -setpoint - ((audio+setpoint)>>1);
+      const int32_t step = (target - gain) >> agc_sub_block_bits;
+      for(uint16_t idx = 0; idx < agc_sub_block_size; ++idx)
+      {
+        //apply gain, in two parts so that the product can't overflow
+        gain += step;
+        const int32_t audio_in = sub_block_audio[idx];
+        int32_t audio_out = audio_in * (gain >> 8) + ((audio_in * (gain & 0xff)) >> 8);
+
+        //soft clip (compress)
+        if (audio_out > setpoint)  audio_out =  setpoint + ((audio_out-setpoint)>>1);
+        if (audio_out < -setpoint) audio_out = -setpoint - ((audio_out+setpoint)>>1);
 
-    //hard clamp
-    if (audio > limit)  audio = limit;
-    if (audio < -limit) audio = -limit;
+        //hard clamp
+        if (audio_out > limit)  audio_out = limit;
+        if (audio_out < -limit) audio_out = -limit;
 
-    return audio;
+        sub_block_audio[idx] = audio_out;
+      }
+      gain = target;
+    }
 }
 
 rx_dsp :: rx_dsp()
 {
   //initialise state
-  phase = 0;
-  frequency=0;
   initialise_luts();
   swap_iq = 0;
   iq_correction = 0;
 
-  //initialise semaphore for spectrum
   set_mode(AM, 2);
-  sem_init(&spectrum_semaphore, 1, 1);
   set_agc_speed(3);
+  set_gain_cal_dB(amplifier_gain_dB);
   filter_control.enable_auto_notch = false;
-
-  //clear cic filter
-  decimate_count=0;
-  integratori1=0; integratorq1=0;
-  integratori2=0; integratorq2=0;
-  integratori3=0; integratorq3=0;
-  integratori4=0; integratorq4=0;
-  delayi0=0; delayq0=0;
-  delayi1=0; delayq1=0;
-  delayi2=0; delayq2=0;
-  delayi3=0; delayq3=0;
+  filter_control.noise_reduction = 0;
+  dual_watch_filter_control = filter_control;
+  set_frequency_offset_Hz(0);
 }
 
 void rx_dsp :: set_auto_notch(bool enable_auto_notch)
 {
-  filter_control.enable_auto_notch = enable_auto_notch;
+  auto_notch_enabled = enable_auto_notch;
+  filter_control.enable_auto_notch = auto_notch_enabled && !shed_auto_notch_now;
+}
+
+//give up features, in the order of the e_shed_level ladder, when short of cycles
+void rx_dsp :: set_load_shedding(uint8_t level)
+{
+  shed_auto_notch_now = level >= shed_auto_notch;
+  filter_control.enable_auto_notch = auto_notch_enabled && !shed_auto_notch_now;
+  freeze_iq_estimation = level >= shed_iq_estimation;
+  skip_capture = level >= shed_spectrum;
+}
+
+void rx_dsp :: set_noise_reduction(uint8_t strength)
+{
+  filter_control.noise_reduction = strength;
+}
+
+void rx_dsp :: set_noise_blanker(uint8_t level)
+{
+  //blanking threshold, as a multiple of the average deviation
+  const uint8_t thresholds[4] = {0, 10, 7, 5};
+  noise_blanker_inst.set_threshold(thresholds[level & 3]);
+}
+
+uint32_t rx_dsp :: get_noise_blanker_impulses()
+{
+  return noise_blanker_inst.get_impulse_count();
 }
 
 void rx_dsp :: set_deemphasis(uint8_t deemph)
@@ -508,18 +591,76 @@ void rx_dsp :: set_agc_speed(uint8_t agc_setting)
   }
 }
 
+void rx_dsp :: set_agc_look_ahead(bool enable)
+{
+  agc_look_ahead = enable;
+}
+
 void rx_dsp :: set_frequency_offset_Hz(double offset_frequency)
 {
   offset_frequency_Hz = offset_frequency;
-  const float bin_width = adc_sample_rate/(cic_decimation_rate*256);
-  filter_control.fft_bin = offset_frequency/bin_width;
-  frequency = ((double)(1ull<<32)*offset_frequency)*cic_decimation_rate/(adc_sample_rate);
+  const float bin_width = (float)adc_sample_rate/(cic_decimation_rate*fft_size);
+  filter_control.fft_bin = roundf(offset_frequency/bin_width);
+  filter_control.rotate_bins = fft_frequency_shift;
+  if(fft_frequency_shift)
+  {
+    //fft filter removes whole bins, the residual is removed at the output sample rate
+    const double residual = offset_frequency - filter_control.fft_bin*bin_width;
+    main_channel.frequency = ((double)(1ull<<32)*residual)*decimation_rate/(adc_sample_rate);
+  }
+  else
+  {
+    main_channel.frequency = ((double)(1ull<<32)*offset_frequency)*cic_decimation_rate/(adc_sample_rate);
+  }
+  update_dual_watch();
+}
+
+void rx_dsp :: set_dual_watch(bool enable, double offset_frequency)
+{
+  dual_watch_enabled = enable;
+  dual_watch_offset_Hz = offset_frequency;
+  update_dual_watch();
+}
+
+//The dual watch channel is taken from the spectrum of the main channel, which
+//is already shifted by the main offset if the time domain mixer is in use.
+//The channel is muted if its pass band falls outside the spectrum. The range
+//is checked before the bins are narrowed, so any offset is safe.
+void rx_dsp :: update_dual_watch()
+{
+  const float bin_width = (float)adc_sample_rate/(cic_decimation_rate*fft_size);
+  const double relative_offset = dual_watch_offset_Hz - (fft_frequency_shift?0.0:offset_frequency_Hz);
+  const float rotation = roundf(relative_offset/bin_width);
+  const float fft_bin = roundf(dual_watch_offset_Hz/bin_width);
+  const float max_bin = fft_size/2 - dual_watch_filter_control.stop_bin;
+  const bool in_window = fabsf(fft_bin) < max_bin && fabsf(rotation) < fft_size;
+
+  dual_watch_active = dual_watch_enabled && in_window;
+  if(!in_window)
+  {
+    dual_watch_filter_control.fft_bin = 0;
+    dual_watch_rotation = 0;
+    dual_watch_channel.frequency = 0;
+    return;
+  }
+
+  const double residual = relative_offset - rotation*bin_width;
+  dual_watch_filter_control.fft_bin = (int16_t)fft_bin;
+  dual_watch_rotation = (int16_t)rotation;
+  dual_watch_channel.frequency = ((double)(1ull<<32)*residual)*decimation_rate/(adc_sample_rate);
+}
+
+void rx_dsp :: set_fft_frequency_shift(bool enable)
+{
+  fft_frequency_shift = enable;
+  set_frequency_offset_Hz(offset_frequency_Hz);
 }
 
 
 void rx_dsp :: set_mode(uint8_t val, uint8_t bw)
 {
   mode = val;
+  //bins are given for a 256 point fft, and scaled for larger ffts
   //                           AM AMS LSB USB NFM CW
   uint8_t start_bins[6]   =  {  0,  0,  3,  3,  0, 0};
 
@@ -531,8 +672,15 @@ void rx_dsp :: set_mode(uint8_t val, uint8_t bw)
 
   filter_control.lower_sideband = (mode != USB);
   filter_control.upper_sideband = (mode != LSB);
-  filter_control.start_bin = start_bins[mode];
-  filter_control.stop_bin = stop_bins[bw][mode];
+  filter_control.start_bin = start_bins[mode] * spectrum_bin_size;
+  filter_control.stop_bin = stop_bins[bw][mode] * spectrum_bin_size;
+
+  //the dual watch channel uses the same mode and bandwidth
+  dual_watch_filter_control.lower_sideband = filter_control.lower_sideband;
+  dual_watch_filter_control.upper_sideband = filter_control.upper_sideband;
+  dual_watch_filter_control.start_bin = filter_control.start_bin;
+  dual_watch_filter_control.stop_bin = filter_control.stop_bin;
+  update_dual_watch();
 }
 
 void rx_dsp :: set_swap_iq(uint8_t val)
@@ -545,6 +693,43 @@ void rx_dsp :: set_iq_correction(uint8_t val)
   iq_correction = val;
 }
 
+void rx_dsp :: set_defer_iq_estimate(bool defer)
+{
+  defer_iq_estimate = defer;
+}
+
+void rx_dsp :: get_iq_dc_estimate(s_iq_dc_estimate &estimate) const
+{
+  estimate.i_avg = i_avg;
+  estimate.q_avg = q_avg;
+  estimate.theta1_filtered = theta1_filtered;
+  estimate.theta2_filtered = theta2_filtered;
+  estimate.theta3_filtered = theta3_filtered;
+  estimate.iq_c1 = iq_c1;
+  estimate.iq_c2 = iq_c2;
+}
+
+void rx_dsp :: set_iq_dc_estimate(const s_iq_dc_estimate &estimate)
+{
+  i_avg = estimate.i_avg;
+  q_avg = estimate.q_avg;
+  theta1_filtered = estimate.theta1_filtered;
+  theta2_filtered = estimate.theta2_filtered;
+  theta3_filtered = estimate.theta3_filtered;
+  iq_c1 = estimate.iq_c1;
+  iq_c2 = estimate.iq_c2;
+
+  //partial sums belong to the old band, start the next ones afresh
+  iq_count = 0;
+  i_accumulator = 0;
+  q_accumulator = 0;
+  iq_index = 0;
+  theta1 = 0;
+  theta2 = 0;
+  theta3 = 0;
+  iq_totals_ready = false;
+}
+
 void rx_dsp :: set_cw_sidetone_Hz(uint16_t val)
 {
   cw_sidetone_frequency_Hz = val;
@@ -553,6 +738,7 @@ void rx_dsp :: set_cw_sidetone_Hz(uint16_t val)
 void rx_dsp :: set_gain_cal_dB(uint16_t val)
 {
   amplifier_gain_dB = val;
+  signal_strength_offset_dB = roundf(65536.0f*(full_scale_dBm - amplifier_gain_dB - 20.0f*log10f(full_scale_signal_strength)));
   s9_threshold = full_scale_signal_strength*powf(10.0f, (S9 - full_scale_dBm + amplifier_gain_dB)/20.0f);
 }
 
@@ -580,25 +766,41 @@ void rx_dsp :: set_squelch(uint8_t val)
 
 int16_t rx_dsp :: get_signal_strength_dBm()
 {
-  if(signal_amplitude == 0)
+  if(main_channel.signal_amplitude == 0)
   {
     return -130;
   }
-  const float signal_strength_dBFS = 20.0*log10f((float)signal_amplitude / full_scale_signal_strength);
-  return roundf(full_scale_dBm - amplifier_gain_dB + signal_strength_dBFS);
+  //20*log10(x) = 20*log10(2)*log2(x), log2 and result with 16 fraction bits
+  const uint32_t amplitude_dB = (log2_fixed(main_channel.signal_amplitude) * 1541u) >> 8;
+  return ((int32_t)amplitude_dB + signal_strength_offset_dB + 32768) >> 16;
 }
 
+//filter configuration in spectrum (256 point) bins, for display
 s_filter_control rx_dsp :: get_filter_config()
 {
-  return capture_filter_control;
+  s_filter_control config = capture_filter_control[captures_published & 1];
+  config.start_bin /= spectrum_bin_size;
+  config.stop_bin /= spectrum_bin_size;
+  config.fft_bin /= spectrum_bin_size;
+  return config;
+}
+
+//position of the dual watch channel relative to the main channel in spectrum
+//(256 point) bins, for display, 0 if dual watch is not active
+int16_t rx_dsp :: get_dual_watch_bin()
+{
+  if(!dual_watch_active) return 0;
+  const float bin_width = (float)adc_sample_rate/(cic_decimation_rate*spectrum_bin_size*fft_size);
+  return roundf((dual_watch_offset_Hz - offset_frequency_Hz)/bin_width);
 }
 
 static int16_t cic_correct(int16_t fft_bin, int16_t fft_offset, uint16_t magnitude)
 {
   int16_t corrected_fft_bin = (fft_bin + fft_offset);
-  if(corrected_fft_bin > 127) corrected_fft_bin -= 256;
-  if(corrected_fft_bin < -128) corrected_fft_bin += 256;
-  uint16_t unsigned_fft_bin = abs(corrected_fft_bin); 
+  if(corrected_fft_bin > fft_size/2 - 1) corrected_fft_bin -= fft_size;
+  if(corrected_fft_bin < -fft_size/2) corrected_fft_bin += fft_size;
+  //correction table is for a 256 point fft
+  uint16_t unsigned_fft_bin = abs(corrected_fft_bin) / spectrum_bin_size; 
   uint32_t adjusted_magnitude = ((uint32_t)magnitude * cic_correction[unsigned_fft_bin]) >> 8;
   return std::min(adjusted_magnitude, (uint32_t)UINT16_MAX);
 }
@@ -613,45 +815,72 @@ static inline uint8_t fft_shift(uint8_t bin)
   return bin ^ 0x80;
 }
 
+//larger ffts are reduced to 256 points for display, keeping the peak of
+//the fft bins making up each point so that narrow signals aren't lost
+static uint16_t spectrum_magnitude(const int16_t capture[], uint8_t point, int16_t fft_offset)
+{
+  uint16_t magnitude = 0;
+  for(uint16_t i=0; i<spectrum_bin_size; ++i)
+  {
+    magnitude = std::max(magnitude, (uint16_t)capture[point*spectrum_bin_size + i]);
+  }
+  return cic_correct(freq_bin(point)*spectrum_bin_size, fft_offset, magnitude);
+}
+
 void rx_dsp :: get_spectrum(uint8_t spectrum[], uint8_t &dB10)
 {
-  //FFT and magnitude
-  sem_acquire_blocking(&spectrum_semaphore);
+  //take the magnitudes from the latest complete frame. Core 1 only starts
+  //to overwrite it once another frame has been published, so if that
+  //happened meanwhile, read again from the newer frame.
+  uint16_t magnitudes[256];
+  uint32_t published;
+  do
+  {
+    published = captures_published;
+    __dmb();
+    const uint8_t front = published & 1;
+    for(uint16_t i=0; i<256; ++i)
+    {
+      magnitudes[i] = spectrum_magnitude(capture[front], i, capture_filter_control[front].fft_bin);
+    }
+    __dmb();
+  } while(captures_published != published);
 
   //find minimum and maximum values
   const uint16_t lowest_max = 2500u;
-  static uint16_t max=65523u;//long term maximum
+  uint16_t &max = spectrum_max;
   uint16_t new_max=0u;
-  static uint16_t min=1u;//long term maximum
+  uint16_t &min = spectrum_min;
   uint16_t new_min=65535u;
   for(uint16_t i=0; i<256; ++i)
   {
-    const uint16_t magnitude = cic_correct(freq_bin(i), capture_filter_control.fft_bin, capture[i]);
+    const uint16_t magnitude = magnitudes[i];
     if(magnitude == 0) continue;
     new_max = std::max(magnitude, new_max);
     new_min = std::min(magnitude, new_min);
   }
   max=max - (max >> 1) + (new_max >> 1);
   min=min - (min >> 1) + (new_min >> 1);
-  const float logmin = log10f(min);
-  const float logmax = log10f(std::max(max, lowest_max));
+  //log2 with 16 fraction bits, the scaling is a ratio so the base doesn't matter
+  const int32_t logmin = log2_fixed(min);
+  const int32_t logmax = log2_fixed(std::max(max, lowest_max));
+  const int32_t logrange = std::max(logmax - logmin, (int32_t)1);
 
   //clamp and convert to log scale 0 -> 255
   for(uint16_t i=0; i<256; i++)
   {
-    const uint16_t magnitude = cic_correct(freq_bin(i), capture_filter_control.fft_bin, capture[i]);
+    const uint16_t magnitude = magnitudes[i];
     if(magnitude == 0)
     {
       spectrum[fft_shift(i)] = 0u;
     } else {
-      const float normalised = 255.0f*(log10f(magnitude)-logmin)/(logmax-logmin);
-      const float clamped = std::max(std::min(normalised, 255.0f), 0.0f);
-      spectrum[fft_shift(i)] = clamped;
+      const int32_t normalised = 255*((int32_t)log2_fixed(magnitude)-logmin)/logrange;
+      spectrum[fft_shift(i)] = std::max(std::min(normalised, (int32_t)255), (int32_t)0);
     }
   }
 
-  sem_release(&spectrum_semaphore);
-
-  //number steps representing 10dB
-  dB10 = 256/(2*logf(max/min));
+  //number steps representing 10dB, 256/(2*ln(max/min))
+  //= 128/(ln(2)*log2(max/min)), with log2 in 16 fraction bits
+  const uint32_t logratio = log2_fixed(max/std::max(min, (uint16_t)1u));
+  dB10 = logratio ? std::min(12102203u/logratio, 255u) : 255u;
 }
@@ -3,80 +3,203 @@
 
 #include <stdint.h>
 #include "rx_definitions.h"
-#include "pico/sem.h"
 #include "fft_filter.h"
+#include "cic_decimator.h"
+#include "noise_blanker.h"
+#include "dsp_profiler.h"
+#include "load_shedder.h"
+
+//state that each receive channel (the main receiver, or the dual watch
+//sub receiver) keeps from block to block after the fft filter
+struct s_rx_channel
+{
+  //residual frequency shift
+  uint32_t phase;
+  int32_t frequency;
+
+  //used in demodulator
+  int32_t audio_dc;
+  int16_t last_i;
+  int16_t last_q;
+  int32_t phi_locked;
+  int32_t freq_locked;
+  int16_t cw_sidetone_phase;
+
+  //de-emphasis
+  int16_t deemphasis_x1;
+  int16_t deemphasis_y1;
+
+  //used in AGC
+  uint16_t hang_timer;
+  int32_t max_hold;
+  int32_t gain; //8 fraction bits
+
+  int32_t signal_amplitude;
+
+  s_rx_channel() :
+    phase(0), frequency(0), audio_dc(0), last_i(0), last_q(0), phi_locked(0),
+    freq_locked(0), cw_sidetone_phase(0), deemphasis_x1(0), deemphasis_y1(0),
+    hang_timer(0), max_hold(0), gain(1 << 8), signal_amplitude(0)
+  {
+  }
+};
+
+//dc offset and iq imbalance estimates, which depend on the band filter in
+//use. Saved when leaving a band and restored on coming back to it.
+struct s_iq_dc_estimate
+{
+  int16_t i_avg;
+  int16_t q_avg;
+  int64_t theta1_filtered;
+  int64_t theta2_filtered;
+  int64_t theta3_filtered;
+  int32_t iq_c1;
+  int32_t iq_c2;
+};
 
 class rx_dsp
 {
+  //host benchmark times the private kernels directly
+  friend class dsp_benchmark;
+
   public:
 
   rx_dsp();
-  uint16_t process_block(uint16_t samples[], int16_t audio_samples[]);
+  uint16_t process_block(uint16_t samples[], int16_t audio_samples[], int16_t dual_watch_samples[] = nullptr);
+
+  //the two halves of process_block, which can run one after the other on
+  //different cores. The front end decimates adc samples into iq_block_size
+  //IQ samples, the back end filters and demodulates them.
+  static const uint16_t iq_block_size = adc_block_size/cic_decimation_rate;
+  void process_front_end(uint16_t samples[], int16_t real[], int16_t imag[]);
+  uint16_t process_back_end(int16_t real[], int16_t imag[], int16_t audio_samples[], int16_t dual_watch_samples[] = nullptr);
   void set_frequency_offset_Hz(double offset_frequency);
+  void set_dual_watch(bool enable, double offset_frequency);
   void set_agc_speed(uint8_t agc_setting);
+  void set_agc_look_ahead(bool enable);
   void set_mode(uint8_t mode, uint8_t bw);
   void set_cw_sidetone_Hz(uint16_t val);
   void set_gain_cal_dB(uint16_t val);
   void set_squelch(uint8_t val);
   void set_swap_iq(uint8_t val);
   void set_iq_correction(uint8_t val);
+  //solve for the iq correction from the latest statistics, if there are new
+  //ones. The front end does this at the end of each block unless deferred,
+  //then the caller does it once the block is out of the way, before the
+  //next block.
+  void set_defer_iq_estimate(bool defer);
+  void update_iq_estimate();
+  void get_iq_dc_estimate(s_iq_dc_estimate &estimate) const;
+  void set_iq_dc_estimate(const s_iq_dc_estimate &estimate);
   void set_deemphasis(uint8_t deemphasis);
   void set_auto_notch(bool enable_auto_notch);
+  void set_load_shedding(uint8_t level);
+  void set_noise_reduction(uint8_t strength);
+  void set_noise_blanker(uint8_t level);
+  uint32_t get_noise_blanker_impulses();
+  void set_fft_frequency_shift(bool enable);
   int16_t get_signal_strength_dBm();
   void get_spectrum(uint8_t spectrum[], uint8_t &dB10);
   s_filter_control get_filter_config();
+  int16_t get_dual_watch_bin();
   void get_spectrum(float spectrum[]);
 
+#ifdef DSP_PROFILE
+  //per stage timing, rx::process_block times the post processing
+  dsp_profiler profiler;
+#endif
+
   private:
   
-  void frequency_shift(int16_t &i, int16_t &q);
-  bool decimate(int16_t &i, int16_t &q);
-  int16_t demodulate(int16_t i, int16_t q);
-  int16_t automatic_gain_control(int16_t audio);
-  int16_t apply_deemphasis(int16_t x);
+  void frequency_shift(int16_t &i, int16_t &q, s_rx_channel &channel);
+  template <uint8_t demod_mode> int16_t demodulate(int16_t i, int16_t q, s_rx_channel &channel);
+  template <uint8_t demod_mode, bool deemph> int32_t demodulate_samples(const int16_t real[], const int16_t imag[], int16_t audio_samples[], bool shift, s_rx_channel &channel);
+  void automatic_gain_control(int16_t audio[], uint16_t num_samples, bool squelched, s_rx_channel &channel);
+  int16_t apply_deemphasis(int16_t x, const int16_t taps[], s_rx_channel &channel);
+  void demodulate_block(int16_t real[], int16_t imag[], int16_t audio_samples[], bool shift, s_rx_channel &channel);
   void iq_imbalance_correction(int16_t &i, int16_t &q);
+  void update_dual_watch();
+
+  //capture samples for spectral analysis, double buffered so that core 0
+  //never waits for core 1. Core 1 averages each block into the back buffer,
+  //then flips the front buffer (captures_published & 1) with a single write.
+  int16_t capture[2][fft_size];
+  s_filter_control capture_filter_control[2];
+  volatile uint32_t captures_published = 0;
 
-  //capture samples for spectral analysis
-  int16_t capture[256];
-  semaphore_t spectrum_semaphore;
+  //long term range of the spectrum, for scaling
+  uint16_t spectrum_max = 65523u;
+  uint16_t spectrum_min = 1u;
+
+  //used in noise blanker
+  noise_blanker noise_blanker_inst;
 
   //used in cic decimator
-  uint8_t decimate_count;
-  int32_t integratori1, integratorq1;
-  int32_t integratori2, integratorq2;
-  int32_t integratori3, integratorq3;
-  int32_t integratori4, integratorq4;
-  int32_t delayi0, delayq0;
-  int32_t delayi1, delayq1;
-  int32_t delayi2, delayq2;
-  int32_t delayi3, delayq3;
+  cic_decimator cic_decimator_inst;
+  int16_t block_real[iq_block_size];
+  int16_t block_imag[iq_block_size];
 
   //used in fft filter
   int16_t fft_bin;
-  fft_filter fft_filter_inst;
+  fft_filter<fft_order> fft_filter_inst;
   s_filter_control filter_control;
-  s_filter_control capture_filter_control;
+  bool auto_notch_enabled = false;
+
+  //load shedding
+  bool shed_auto_notch_now = false;
+  bool skip_capture = false;
+
+  //dc removal, averaged over 2048 samples
+  uint16_t iq_count = 0;
+  int32_t i_accumulator = 0;
+  int32_t q_accumulator = 0;
+  int16_t i_avg = 0;
+  int16_t q_avg = 0;
+
+  //iq imbalance estimate, and the correction from it
+  uint16_t iq_index = 0;
+  int32_t theta1 = 0;
+  int32_t theta2 = 0;
+  int32_t theta3 = 0;
+  int32_t theta1_total = 0;
+  int32_t theta2_total = 0;
+  int32_t theta3_total = 0;
+  bool iq_totals_ready = false;
+  bool defer_iq_estimate = false;
+  int64_t theta1_filtered = 0;
+  int64_t theta2_filtered = 0;
+  int64_t theta3_filtered = 0;
+  int32_t iq_c1 = 0;
+  int32_t iq_c2 = 0;
 
   //used in frequency shifter
   uint8_t swap_iq;
   uint8_t iq_correction;
-  int32_t offset_frequency_Hz;
+  bool freeze_iq_estimation = false;
+  double offset_frequency_Hz;
+  bool fft_frequency_shift = true;
   int32_t dither;
-  uint32_t phase;
-  int32_t frequency;
+
+  //main receiver
+  s_rx_channel main_channel;
+
+  //dual watch sub receiver, filtered from the same forward fft
+  s_rx_channel dual_watch_channel;
+  s_filter_control dual_watch_filter_control;
+  bool dual_watch_enabled = false;
+  bool dual_watch_active = false;
+  double dual_watch_offset_Hz = 0.0;
+  uint16_t dual_watch_rotation = 0;
+  int16_t dual_watch_real[adc_block_size/decimation_rate];
+  int16_t dual_watch_imag[adc_block_size/decimation_rate];
 
   //used to generate cw sidetone
   int16_t cw_i, cw_q;
-  int16_t cw_sidetone_phase;
   int16_t cw_sidetone_frequency_Hz=1000;
 
-  int32_t signal_amplitude;
-
   //used in demodulator
   int32_t mode=0;
-  int32_t audio_dc=0;
   uint8_t ssb_phase=0;
-  int16_t last_phase=0;
 
   // de-emphasis
   uint8_t deemphasis=0;
@@ -89,14 +212,16 @@ class rx_dsp
   uint8_t attack_factor;
   uint8_t decay_factor;
   uint16_t hang_time;
-  uint16_t hang_timer;
-  int32_t max_hold;
-  int16_t gain;
   int16_t manual_gain;
   bool manual_gain_control = false;
+  bool agc_look_ahead = false;
+  static const uint8_t agc_sub_block_bits = 3;
+  static const uint16_t agc_sub_block_size = 1u << agc_sub_block_bits;
+  static const uint16_t max_agc_sub_blocks = (adc_block_size/decimation_rate) >> agc_sub_block_bits;
 
   // gain calibration
   float amplifier_gain_dB = 62.0f;
+  int32_t signal_strength_offset_dB; //16 fraction bits
   int32_t usb_buf_level_avg = 0;
 
 };
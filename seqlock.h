@@ -0,0 +1,50 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <stdint.h>
+#include "hardware/sync.h"
+
+//Exchange of a struct between the cores, with one writer and any readers
+//
+//The writer never waits. It makes the sequence number odd while it copies
+//a new value in, and even again once it is done. A reader copies the value
+//out and checks that the sequence was even and didn't change meanwhile, so
+//it always gets all of one value. A reader only has to retry when it
+//overlaps a write, which is just a copy of the struct.
+template <typename T>
+class seqlock
+{
+  volatile uint32_t sequence;
+  T value;
+
+  public:
+  seqlock() : sequence(0), value() {}
+
+  void write(const T &new_value)
+  {
+    const uint32_t start = sequence;
+    sequence = start + 1;
+    __dmb();
+    value = new_value;
+    __dmb();
+    sequence = start + 2;
+  }
+
+  //false if a write was in progress, result may then be inconsistent
+  bool try_read(T &result) const
+  {
+    const uint32_t start = sequence;
+    __dmb();
+    if(start & 1u) return false;
+    result = value;
+    __dmb();
+    return sequence == start;
+  }
+
+  void read(T &result) const
+  {
+    while(!try_read(result));
+  }
+};
+
+#endif
@@ -0,0 +1,124 @@
+//Check that the block CIC decimator is bit-exact with the original
+//per-sample implementation, which split I and Q by multiplying each raw
+//sample by 0 or 1 and ran both integrator chains at the full ADC rate.
+
+#include "cic_decimator.h"
+#include "rx_definitions.h"
+#include <cstdio>
+
+class reference_decimator
+{
+  uint8_t decimate_count = 0;
+  uint32_t integratori1 = 0, integratorq1 = 0;
+  uint32_t integratori2 = 0, integratorq2 = 0;
+  uint32_t integratori3 = 0, integratorq3 = 0;
+  uint32_t integratori4 = 0, integratorq4 = 0;
+  uint32_t delayi0 = 0, delayq0 = 0;
+  uint32_t delayi1 = 0, delayq1 = 0;
+  uint32_t delayi2 = 0, delayq2 = 0;
+  uint32_t delayi3 = 0, delayq3 = 0;
+
+  bool decimate(int16_t &i, int16_t &q)
+  {
+    integratori1 += i;
+    integratorq1 += q;
+    integratori2 += integratori1;
+    integratorq2 += integratorq1;
+    integratori3 += integratori2;
+    integratorq3 += integratorq2;
+    integratori4 += integratori3;
+    integratorq4 += integratorq3;
+
+    decimate_count++;
+    if(decimate_count >= cic_decimation_rate)
+    {
+      decimate_count = 0;
+      const uint32_t combi1 = integratori4-delayi0;
+      const uint32_t combq1 = integratorq4-delayq0;
+      const uint32_t combi2 = combi1-delayi1;
+      const uint32_t combq2 = combq1-delayq1;
+      const uint32_t combi3 = combi2-delayi2;
+      const uint32_t combq3 = combq2-delayq2;
+      const uint32_t combi4 = combi3-delayi3;
+      const uint32_t combq4 = combq3-delayq3;
+      delayi0 = integratori4;
+      delayq0 = integratorq4;
+      delayi1 = combi1;
+      delayq1 = combq1;
+      delayi2 = combi2;
+      delayq2 = combq2;
+      delayi3 = combi3;
+      delayq3 = combq3;
+      i = (int32_t)combi4>>(cic_bit_growth-extra_bits);
+      q = (int32_t)combq4>>(cic_bit_growth-extra_bits);
+      return true;
+    }
+    return false;
+  }
+
+  public:
+  void process_block(const uint16_t samples[], int16_t real[], int16_t imag[], bool swap_iq)
+  {
+    uint16_t odx = 0;
+    for(uint16_t idx=0; idx<adc_block_size; idx++)
+    {
+      const int16_t raw_sample = samples[idx];
+      int16_t i = ((idx&1)^1^swap_iq)*raw_sample;
+      int16_t q = ((idx&1)^swap_iq)*raw_sample;
+      if(decimate(i, q))
+      {
+        real[odx] = i;
+        imag[odx] = q;
+        ++odx;
+      }
+    }
+  }
+};
+
+int main()
+{
+  static cic_decimator decimator;
+  static reference_decimator reference;
+  uint16_t samples[adc_block_size];
+  int16_t real[adc_block_size/cic_decimation_rate], imag[adc_block_size/cic_decimation_rate];
+  int16_t ref_real[adc_block_size/cic_decimation_rate], ref_imag[adc_block_size/cic_decimation_rate];
+
+  uint32_t lcg = 1u;
+  uint32_t errors = 0;
+  for(uint16_t block=0; block<1000; ++block)
+  {
+    for(uint16_t idx=0; idx<adc_block_size; ++idx)
+    {
+      lcg = lcg * 1664525u + 1013904223u;
+      if(block < 100)
+      {
+        samples[idx] = 4095; //full scale DC, exercises integrator wraparound
+      }
+      else
+      {
+        samples[idx] = (lcg >> 20) & 0xfff;
+      }
+    }
+
+    //swap i and q part way through, state must carry across correctly
+    const bool swap_iq = (block >= 400 && block < 700);
+    decimator.process_block(samples, real, imag, swap_iq);
+    reference.process_block(samples, ref_real, ref_imag, swap_iq);
+
+    for(uint16_t idx=0; idx<adc_block_size/cic_decimation_rate; ++idx)
+    {
+      if(real[idx] != ref_real[idx] || imag[idx] != ref_imag[idx])
+      {
+        if(errors < 10)
+        {
+          printf("block %u sample %u: got %i %i expected %i %i\n",
+              block, idx, real[idx], imag[idx], ref_real[idx], ref_imag[idx]);
+        }
+        errors++;
+      }
+    }
+  }
+
+  printf("%u mismatches\n", errors);
+  return errors ? 1 : 0;
+}
@@ -0,0 +1,262 @@
+//Check the sequencing of the ADC and PWM DMA ring without a board.
+//
+//A small model of the DMA channels is wired up the way rx::run does it: data
+//channels re-armed by control channels that read slot addresses from a list
+//using a read ring. The ADC and PWM are paced from one clock, the PWM
+//slightly fast as it is on the board. A model of the DSP processes each block,
+//sometimes stalling, and the test checks that every block is read before it
+//is overwritten, that audio is played in order and from the right block, and
+//that the overrun and underrun counts match the blocks that were lost.
+
+#include "dma_ring.h"
+#include <cstdio>
+#include <cstring>
+
+static const uint16_t block_size = 16;                 //adc samples per block
+static const uint16_t audio_block_size = block_size/2; //pwm samples per block
+static const uint32_t adc_period = 100;
+static const uint32_t pwm_period = 199;
+static const uint32_t block_period = block_size * adc_period;
+
+struct s_channel;
+static s_channel *channels[4];
+
+//the registers of a channel that a control channel can write
+enum e_target { write_addr_trig, read_addr_trig };
+
+struct s_channel
+{
+  uintptr_t read_addr = 0;
+  uintptr_t write_addr = 0;
+  uint32_t reload = 0;
+  uint32_t count = 0;
+  bool busy = false;
+  uint8_t size = 2;
+  bool read_increment = false;
+  bool write_increment = false;
+  uint8_t read_ring_bits = 0;  //0 = no ring
+  int8_t chain_to = -1;
+  int8_t target = -1;          //control channels write a register of this channel
+  e_target target_register = write_addr_trig;
+  uint32_t completions = 0;
+
+  //a trigger reloads the transfer count
+  void trigger()
+  {
+    count = reload;
+    busy = true;
+  }
+
+  void advance_read()
+  {
+    if(!read_increment) return;
+    const uintptr_t next = read_addr + size;
+    if(read_ring_bits)
+    {
+      const uintptr_t mask = ((uintptr_t)1 << read_ring_bits) - 1;
+      read_addr = (read_addr & ~mask) | (next & mask);
+    }
+    else
+    {
+      read_addr = next;
+    }
+  }
+
+  //one transfer, when the dreq allows
+  void transfer(uint16_t *dreq_source, uint16_t *dreq_destination)
+  {
+    if(!busy) return;
+    if(target >= 0)
+    {
+      s_channel &t = *channels[target];
+      const uintptr_t value = *(const uintptr_t *)read_addr;
+      if(target_register == write_addr_trig) t.write_addr = value;
+      else t.read_addr = value;
+      t.trigger();
+    }
+    else
+    {
+      const uint16_t *source = dreq_source ? dreq_source : (const uint16_t *)read_addr;
+      uint16_t *destination = dreq_destination ? dreq_destination : (uint16_t *)write_addr;
+      *destination = *source;
+    }
+    advance_read();
+    if(write_increment) write_addr += size;
+    if(--count) return;
+    busy = false;
+    completions++;
+    if(chain_to >= 0)
+    {
+      channels[chain_to]->trigger();
+      //control channels don't need a dreq, they run straight away
+      if(channels[chain_to]->target >= 0) channels[chain_to]->transfer(nullptr, nullptr);
+    }
+  }
+};
+
+static bool run_test(const char *name, uint8_t requested_depth, const uint32_t stall_blocks[], uint32_t num_stalls,
+    uint32_t expected_overruns, uint32_t expected_underruns)
+{
+  static uint16_t adc_ring[max_dma_ring_depth][block_size];
+  static uint16_t audio_ring[max_dma_ring_depth][audio_block_size];
+  static s_dma_control_list adc_control_list, audio_control_list;
+  const uint32_t num_blocks = 200;
+
+  dma_ring ring;
+  ring.start(requested_depth);
+  const uint8_t depth = ring.get_depth();
+  memset(audio_ring, 0xff, sizeof(audio_ring));
+
+  s_channel adc, adc_control, pwm, pwm_control;
+  channels[0] = &adc; channels[1] = &adc_control; channels[2] = &pwm; channels[3] = &pwm_control;
+
+  //the same wiring as rx::run
+  ring.fill_control_list(adc_control_list, adc_ring, sizeof(adc_ring[0]));
+  ring.fill_control_list(audio_control_list, audio_ring, sizeof(audio_ring[0]));
+  adc.write_increment = true;
+  adc.reload = block_size;
+  adc.write_addr = (uintptr_t)adc_ring[0];
+  adc.chain_to = 1;
+  pwm.read_increment = true;
+  pwm.reload = audio_block_size;
+  pwm.read_addr = (uintptr_t)audio_ring[0];
+  s_channel *controls[] = {&adc_control, &pwm_control};
+  for(s_channel *control : controls)
+  {
+    control->size = sizeof(uintptr_t);
+    control->read_increment = true;
+    control->read_ring_bits = ring.control_ring_bits();
+    control->reload = 1;
+  }
+  adc_control.read_addr = (uintptr_t)adc_control_list.address;
+  adc_control.target = 0;
+  adc_control.target_register = write_addr_trig;
+  adc_control.chain_to = 3;
+  pwm_control.read_addr = (uintptr_t)audio_control_list.address;
+  pwm_control.target = 2;
+  pwm_control.target_register = read_addr_trig;
+
+  //start
+  adc_control.trigger();
+  adc_control.transfer(nullptr, nullptr);
+
+  uint16_t adc_sample = 0;
+  uint16_t pwm_output = 0;
+  uint32_t errors = 0;
+
+  //the dsp
+  bool processing = false;
+  uint32_t block = 0;
+  uint32_t finish_time = 0;
+  uint32_t processed = 0;
+  uint32_t late = 0;
+  bool on_time[num_blocks + max_dma_ring_depth] = {};
+
+  //audio played for each pwm trigger
+  uint32_t pwm_triggers = 0;
+  uint16_t played[audio_block_size];
+  uint16_t num_played = 0;
+  uint32_t stale = 0;
+
+  for(uint32_t time = 0; adc.completions < num_blocks; ++time)
+  {
+    if(time % adc_period == 0)
+    {
+      adc.transfer(&adc_sample, nullptr);
+      adc_sample++;
+    }
+
+    //check the audio played for each block once its slot is restarted
+    if(pwm_control.completions != pwm_triggers)
+    {
+      const int32_t audio_block = (int32_t)pwm_triggers - 1 - depth;
+      if(audio_block >= 0)
+      {
+        bool correct = num_played == audio_block_size;
+        for(uint16_t idx = 0; idx < num_played; ++idx)
+        {
+          correct &= played[idx] == (uint16_t)(audio_block * audio_block_size + idx);
+        }
+        if(!correct) stale++;
+        if(correct != on_time[audio_block]) errors++;
+      }
+      pwm_triggers = pwm_control.completions;
+      num_played = 0;
+    }
+    if(time % pwm_period == 0 && pwm.busy)
+    {
+      pwm.transfer(nullptr, &pwm_output);
+      if(num_played < audio_block_size) played[num_played++] = pwm_output;
+    }
+
+    if(!processing && ring.block_ready(adc.completions))
+    {
+      block = ring.next_block(adc.completions);
+      const uint8_t slot = ring.slot(block);
+      for(uint16_t idx = 0; idx < block_size; ++idx)
+      {
+        if(adc_ring[slot][idx] != (uint16_t)(block * block_size + idx)) errors++;
+      }
+      uint32_t duration = block_period / 2 + 37;
+      for(uint32_t i = 0; i < num_stalls; ++i)
+      {
+        if(stall_blocks[2*i] == block) duration = stall_blocks[2*i + 1] * block_period + 37;
+      }
+      finish_time = time + duration;
+      processing = true;
+    }
+    if(processing && time == finish_time)
+    {
+      const uint8_t slot = ring.slot(block);
+      for(uint16_t idx = 0; idx < audio_block_size; ++idx)
+      {
+        audio_ring[slot][idx] = block * audio_block_size + idx;
+      }
+      const uint32_t underruns = ring.get_underruns();
+      ring.block_done(adc.completions);
+      on_time[block] = ring.get_underruns() == underruns;
+
+      //blocks finished in time must not have been overwritten while processing
+      for(uint16_t idx = 0; on_time[block] && idx < block_size; ++idx)
+      {
+        if(adc_ring[slot][idx] != (uint16_t)(block * block_size + idx)) errors++;
+      }
+      late += !on_time[block];
+      processed++;
+      processing = false;
+    }
+  }
+
+  const bool pass = errors == 0 && ring.get_overruns() == expected_overruns && ring.get_underruns() == expected_underruns &&
+      late == ring.get_underruns() && processed + ring.get_overruns() >= num_blocks - depth;
+  printf("%s, depth %u: %u blocks processed, %u overruns, %u underruns, %u stale audio blocks, %u errors %s\n",
+      name, depth, (unsigned)processed, (unsigned)ring.get_overruns(), (unsigned)ring.get_underruns(),
+      (unsigned)stale, (unsigned)errors, pass?"pass":"FAIL");
+  return pass;
+}
+
+int main()
+{
+  bool pass = true;
+
+  //depths round down to a power of 2
+  pass &= dma_ring::valid_depth(0) == 2 && dma_ring::valid_depth(3) == 2 && dma_ring::valid_depth(4) == 4;
+  pass &= dma_ring::valid_depth(255) == max_dma_ring_depth;
+
+  //stalls given as pairs of block, duration in blocks
+  const uint32_t none[] = {0, 0};
+  const uint32_t short_stall[] = {50, 2};
+  const uint32_t long_stall[] = {50, 6};
+  pass &= run_test("no stalls", 2, none, 0, 0, 0);
+  pass &= run_test("no stalls", 4, none, 0, 0, 0);
+
+  //a two block stall is absorbed by a deeper ring
+  pass &= run_test("short stall", 2, short_stall, 1, 1, 1);
+  pass &= run_test("short stall", 4, short_stall, 1, 0, 0);
+
+  //a longer stall loses blocks, and then processing catches up
+  pass &= run_test("long stall", 2, long_stall, 1, 5, 1);
+  pass &= run_test("long stall", 4, long_stall, 1, 5, 1);
+
+  return pass ? 0 : 1;
+}
@@ -0,0 +1,329 @@
+//Per-kernel timing of the receiver DSP chain on a host PC
+//
+//Each kernel is timed over many repetitions of the work it does for one
+//2048 sample ADC block. Times are normalised to ns per ADC input sample so
+//that kernels running at different rates can be compared directly, and are
+//reported against the block deadline (the time the DMA takes to fill the
+//next block). Results are written to stdout as JSON so that two runs can be
+//diffed.
+//
+//Host timings don't translate directly to RP2040/RP2350 cycles, but the
+//relative cost of each kernel, and how it changes from one commit to the
+//next, does.
+
+#include "rx_dsp.h"
+#include "rx_definitions.h"
+#include "fft_filter.h"
+#include "fft.h"
+#include "cic_decimator.h"
+#include "noise_blanker.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+static const char *mode_names[] = {"AM", "AMSYNC", "LSB", "USB", "FM", "CW"};
+static volatile int32_t sink;
+
+//deterministic test data, a tone plus noise
+static uint32_t lcg_state = 12345u;
+static int16_t noise(int16_t amplitude)
+{
+  lcg_state = lcg_state * 1664525u + 1013904223u;
+  return (int16_t)((int32_t)(lcg_state >> 16) % (2 * amplitude + 1) - amplitude);
+}
+
+struct s_result
+{
+  const char *name;
+  double ns_per_call;
+  uint32_t calls_per_block;
+};
+
+class dsp_benchmark
+{
+  public:
+
+  dsp_benchmark(uint32_t iterations, uint32_t repeats) : iterations(iterations), repeats(repeats)
+  {
+    for(uint16_t idx=0; idx<adc_block_size; ++idx)
+    {
+      //I on even samples, Q on odd samples
+      const float phase = 2.0f * (float)M_PI * 5000.0f * (idx >> 1) / (adc_sample_rate / 2);
+      const float value = (idx & 1) ? sinf(phase) : cosf(phase);
+      adc_samples[idx] = 2048 + (int16_t)(600.0f * value) + noise(50);
+    }
+    for(uint16_t idx=0; idx<fft_size; ++idx)
+    {
+      const float phase = 2.0f * (float)M_PI * 9.0f * idx / fft_size;
+      iq_real[idx] = 4000.0f * cosf(phase) + noise(200);
+      iq_imag[idx] = 4000.0f * sinf(phase) + noise(200);
+    }
+  }
+
+  //time fn, returning the fastest mean time per call over all the repeats
+  template <typename F>
+  double time_ns(F fn)
+  {
+    double best = 1e30;
+    for(uint32_t repeat=0; repeat<repeats; ++repeat)
+    {
+      const auto start = std::chrono::steady_clock::now();
+      for(uint32_t iteration=0; iteration<iterations; ++iteration)
+      {
+        fn();
+      }
+      const auto elapsed = std::chrono::steady_clock::now() - start;
+      const double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+      best = std::min(best, ns / iterations);
+    }
+    return best;
+  }
+
+  uint16_t run(s_result results[])
+  {
+    uint16_t num_results = 0;
+    static rx_dsp dsp;
+    dsp.set_frequency_offset_Hz(5000.0);
+    dsp.set_mode(AM, 2);
+
+    const uint16_t new_fft_size = fft_filter<fft_order>::new_fft_size;
+
+    //forward FFT, one fft_size point FFT per block
+    {
+      int16_t real[fft_size], imag[fft_size];
+      const double ns = time_ns([&]{
+        memcpy(real, iq_real, sizeof(real));
+        memcpy(imag, iq_imag, sizeof(imag));
+        fixed_fft<fft_order>(real, imag);
+        sink = real[1];
+      });
+      results[num_results++] = {"fixed_fft", ns, 1};
+    }
+
+    //inverse FFT, one fft_size/2 point IFFT per block
+    {
+      int16_t real[new_fft_size], imag[new_fft_size];
+      const double ns = time_ns([&]{
+        memcpy(real, iq_real, sizeof(real));
+        memcpy(imag, iq_imag, sizeof(imag));
+        fixed_ifft<fft_order-1>(real, imag);
+        sink = real[1];
+      });
+      results[num_results++] = {"fixed_ifft", ns, 1};
+    }
+
+    //overlap/add fft filter, fft_size/2 decimated samples per block
+    {
+      static fft_filter<fft_order> filter;
+      static int16_t capture[fft_size];
+      s_filter_control filter_control;
+      filter_control.start_bin = 0;
+      filter_control.stop_bin = 25 * spectrum_bin_size;
+      filter_control.fft_bin = 0;
+      filter_control.lower_sideband = true;
+      filter_control.upper_sideband = true;
+      filter_control.capture = true;
+      filter_control.enable_auto_notch = false;
+      filter_control.rotate_bins = false;
+      filter_control.noise_reduction = 0;
+      int16_t real[new_fft_size], imag[new_fft_size];
+      const double ns = time_ns([&]{
+        memcpy(real, iq_real, sizeof(real));
+        memcpy(imag, iq_imag, sizeof(imag));
+        filter.process_sample(real, imag, filter_control, capture);
+        sink = real[1];
+      });
+      results[num_results++] = {"fft_filter_process_sample", ns, 1};
+    }
+
+    //dual watch channel, filtered from the spectrum of the last frame
+    {
+      static fft_filter<fft_order> filter;
+      static int16_t capture[fft_size];
+      s_filter_control filter_control;
+      filter_control.start_bin = 0;
+      filter_control.stop_bin = 25 * spectrum_bin_size;
+      filter_control.fft_bin = 0;
+      filter_control.lower_sideband = true;
+      filter_control.upper_sideband = true;
+      filter_control.capture = false;
+      filter_control.enable_auto_notch = false;
+      filter_control.rotate_bins = false;
+      filter_control.noise_reduction = 0;
+      int16_t real[new_fft_size], imag[new_fft_size];
+      memcpy(real, iq_real, sizeof(real));
+      memcpy(imag, iq_imag, sizeof(imag));
+      filter.process_sample(real, imag, filter_control, capture);
+      const double ns = time_ns([&]{
+        filter.process_sub_channel(real, imag, filter_control, 33 * spectrum_bin_size);
+        sink = real[1];
+      });
+      results[num_results++] = {"fft_filter_process_sub_channel", ns, 1};
+    }
+
+    //noise blanker, one block of ADC samples per call
+    {
+      static noise_blanker blanker;
+      static uint16_t samples[adc_block_size];
+      blanker.set_threshold(7);
+      const double ns = time_ns([&]{
+        memcpy(samples, adc_samples, sizeof(samples));
+        blanker.process_block(samples);
+        sink = samples[0];
+      });
+      results[num_results++] = {"noise_blanker_process_block", ns, 1};
+    }
+
+    //CIC decimator, one block of ADC samples per call
+    {
+      static cic_decimator decimator;
+      int16_t real[adc_block_size/cic_decimation_rate];
+      int16_t imag[adc_block_size/cic_decimation_rate];
+      const double ns = time_ns([&]{
+        decimator.process_block(adc_samples, real, imag, false);
+        sink = real[0];
+      });
+      results[num_results++] = {"cic_decimator_process_block", ns, 1};
+    }
+
+    //frequency shift, called once per CIC output sample
+    {
+      const uint16_t n = adc_block_size/cic_decimation_rate;
+      const double ns = time_ns([&]{
+        int32_t total = 0;
+        for(uint16_t idx=0; idx<n; ++idx)
+        {
+          int16_t i = iq_real[idx];
+          int16_t q = iq_imag[idx];
+          dsp.frequency_shift(i, q, dsp.main_channel);
+          total += i;
+        }
+        sink = total;
+      });
+      results[num_results++] = {"rx_dsp_frequency_shift", ns / n, n};
+    }
+
+    //demodulator, with de-emphasis, agc and squelch, once per block of audio samples
+    static char demodulate_names[6][32];
+    for(uint8_t mode=0; mode<6; ++mode)
+    {
+      const uint16_t n = adc_block_size/decimation_rate;
+      static int16_t audio[adc_block_size/decimation_rate];
+      dsp.set_mode(mode, 2);
+      const double ns = time_ns([&]{
+        dsp.demodulate_block(iq_real, iq_imag, audio, false, dsp.main_channel);
+        sink = audio[n-1];
+      });
+      snprintf(demodulate_names[mode], sizeof(demodulate_names[mode]), "rx_dsp_demodulate_%s", mode_names[mode]);
+      results[num_results++] = {demodulate_names[mode], ns / n, n};
+    }
+
+    //agc, once per block of audio samples
+    {
+      const uint16_t n = adc_block_size/decimation_rate;
+      static int16_t audio[adc_block_size/decimation_rate];
+      dsp.set_agc_speed(3);
+      const double ns = time_ns([&]{
+        for(uint16_t idx=0; idx<n; ++idx) audio[idx] = iq_real[idx];
+        dsp.automatic_gain_control(audio, n, false, dsp.main_channel);
+        sink = audio[n-1];
+      });
+      results[num_results++] = {"rx_dsp_automatic_gain_control", ns / n, n};
+    }
+
+    //complete chain, once per block
+    {
+      static char names[6][32];
+      for(uint8_t mode=0; mode<6; ++mode)
+      {
+        static rx_dsp chain;
+        chain.set_frequency_offset_Hz(5000.0);
+        chain.set_mode(mode, 2);
+        int16_t audio[adc_block_size/decimation_rate];
+        const double ns = time_ns([&]{
+          chain.process_block(adc_samples, audio);
+          sink = audio[0];
+        });
+        snprintf(names[mode], sizeof(names[mode]), "rx_dsp_process_block_%s", mode_names[mode]);
+        results[num_results++] = {names[mode], ns, 1};
+      }
+    }
+
+    return num_results;
+  }
+
+  private:
+  uint32_t iterations;
+  uint32_t repeats;
+  uint16_t adc_samples[adc_block_size];
+  int16_t iq_real[fft_size];
+  int16_t iq_imag[fft_size];
+};
+
+static void usage(const char *name)
+{
+  fprintf(stderr, "usage: %s [-n iterations] [-r repeats] [-c clock_MHz]\n", name);
+  fprintf(stderr, "  -n iterations  calls per measurement (default 2000)\n");
+  fprintf(stderr, "  -r repeats     measurements per kernel, fastest is reported (default 5)\n");
+  fprintf(stderr, "  -c clock_MHz   host clock used to estimate cycles (default 0, omit cycles)\n");
+}
+
+int main(int argc, char *argv[])
+{
+  uint32_t iterations = 2000;
+  uint32_t repeats = 5;
+  double clock_MHz = 0.0;
+
+  int opt;
+  while((opt = getopt(argc, argv, "n:r:c:h")) != -1)
+  {
+    switch(opt)
+    {
+      case 'n': iterations = std::max(atoi(optarg), 1); break;
+      case 'r': repeats = std::max(atoi(optarg), 1); break;
+      case 'c': clock_MHz = atof(optarg); break;
+      default:
+        usage(argv[0]);
+        return opt == 'h' ? 0 : 1;
+    }
+  }
+
+  static dsp_benchmark benchmark(iterations, repeats);
+  s_result results[32];
+  const uint16_t num_results = benchmark.run(results);
+
+  const double deadline_ns = 1e9 * adc_block_size / adc_sample_rate;
+  printf("{\n");
+  printf("  \"fft_size\": %u,\n", fft_size);
+  printf("  \"adc_block_size\": %u,\n", adc_block_size);
+  printf("  \"adc_sample_rate\": %u,\n", adc_sample_rate);
+  printf("  \"block_deadline_ns\": %.0f,\n", deadline_ns);
+  printf("  \"iterations\": %u,\n", iterations);
+  printf("  \"repeats\": %u,\n", repeats);
+  printf("  \"clock_MHz\": %.1f,\n", clock_MHz);
+  printf("  \"kernels\": [\n");
+  for(uint16_t idx=0; idx<num_results; ++idx)
+  {
+    const s_result &r = results[idx];
+    const double ns_per_block = r.ns_per_call * r.calls_per_block;
+    const double ns_per_sample = ns_per_block / adc_block_size;
+    printf("    {\"name\": \"%s\", \"calls_per_block\": %u, \"ns_per_call\": %.2f, "
+        "\"ns_per_input_sample\": %.3f, \"ns_per_block\": %.0f, \"deadline_pct\": %.2f, "
+        "\"headroom_pct\": %.2f",
+        r.name, r.calls_per_block, r.ns_per_call, ns_per_sample, ns_per_block,
+        100.0 * ns_per_block / deadline_ns, 100.0 * (1.0 - ns_per_block / deadline_ns));
+    if(clock_MHz > 0.0)
+    {
+      printf(", \"cycles_per_input_sample\": %.2f", ns_per_sample * clock_MHz / 1000.0);
+    }
+    printf("}%s\n", idx + 1 < num_results ? "," : "");
+  }
+  printf("  ]\n");
+  printf("}\n");
+
+  return 0;
+}
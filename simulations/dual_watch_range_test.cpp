@@ -0,0 +1,41 @@
+//Check that a dual watch frequency outside the spectrum mutes the sub
+//channel, however far away it is, including the erased flash value that
+//the watched frequency once defaulted to (about 4.29GHz).
+
+#include "rx_dsp.h"
+#include "rx_definitions.h"
+#include <cstdio>
+
+static const uint16_t audio_block_size = adc_block_size/decimation_rate;
+
+static bool muted(double offset_Hz)
+{
+  static rx_dsp dsp;
+  static uint16_t samples[adc_block_size];
+  int16_t audio[audio_block_size];
+  int16_t dual_watch[audio_block_size];
+  for(uint16_t idx = 0; idx < adc_block_size; ++idx) samples[idx] = 2048 + ((idx * 37) & 255);
+  dsp.set_dual_watch(true, offset_Hz);
+  bool silent = dsp.get_dual_watch_bin() == 0;
+  for(uint8_t block = 0; block < 8; ++block)
+  {
+    dsp.process_block(samples, audio, dual_watch);
+    for(int16_t sample : dual_watch) silent &= sample == 0;
+  }
+  printf("offset %14.0f Hz: %s\n", offset_Hz, silent?"muted":"active");
+  return silent;
+}
+
+int main()
+{
+  const double spectrum_Hz = (double)adc_sample_rate/cic_decimation_rate;
+  bool pass = true;
+  pass &= !muted(spectrum_Hz/8);
+  pass &= muted(spectrum_Hz/2);
+  pass &= muted(-spectrum_Hz);
+  pass &= muted(4294967295.0);
+  pass &= muted(-4294967295.0);
+  pass &= muted(1e12);
+  printf("%s\n", pass?"pass":"FAIL");
+  return pass ? 0 : 1;
+}
@@ -2,36 +2,257 @@
 #include <cstdio>
 #include <cmath>
 
-int main()
+//pass a tone through the filter, and return the rms output once settled
+template<uint8_t order>
+double filter_tone(double cycles_per_sample, uint16_t stop_bin)
+{
+  static const uint16_t fft_size = fft_filter<order>::fft_size;
+  static const uint16_t new_fft_size = fft_filter<order>::new_fft_size;
+  static fft_filter<order> filt;
+  static int16_t capture[fft_size];
+
+  s_filter_control fc;
+  fc.start_bin = 0;
+  fc.stop_bin = stop_bin;
+  fc.fft_bin = 0;
+  fc.upper_sideband = true;
+  fc.lower_sideband = true;
+  fc.capture = false;
+  fc.enable_auto_notch = false;
+  fc.rotate_bins = false;
+  fc.noise_reduction = 0;
+
+  uint32_t t = 0;
+  double sum = 0;
+  uint32_t count = 0;
+  for(uint8_t j=0; j<8; ++j)
+  {
+    int16_t i[fft_size/2];
+    int16_t q[fft_size/2];
+    for(uint16_t idx = 0; idx<fft_size/2; ++idx)
+    {
+      i[idx] = cos(2.0*M_PI*cycles_per_sample*t)*512;
+      q[idx] = sin(2.0*M_PI*cycles_per_sample*t)*512;
+      t++;
+    }
+
+    filt.process_sample(i, q, fc, capture);
+
+    if(j < 2) continue;
+    for(uint16_t idx = 0; idx<new_fft_size/2; ++idx)
+    {
+      sum += (double)i[idx]*i[idx] + (double)q[idx]*q[idx];
+      count++;
+    }
+  }
+  return sqrt(sum/count);
+}
+
+//pass white noise through the filter, and return the rms output once the
+//noise reduction has settled
+template<uint8_t order>
+double filter_noise(uint8_t noise_reduction)
+{
+  static const uint16_t fft_size = fft_filter<order>::fft_size;
+  static const uint16_t new_fft_size = fft_filter<order>::new_fft_size;
+  fft_filter<order> *filt = new fft_filter<order>;
+  static int16_t capture[fft_size];
+
+  s_filter_control fc;
+  fc.start_bin = 0;
+  fc.stop_bin = 32*(fft_size/256u);
+  fc.fft_bin = 0;
+  fc.upper_sideband = true;
+  fc.lower_sideband = true;
+  fc.capture = false;
+  fc.enable_auto_notch = false;
+  fc.rotate_bins = false;
+  fc.noise_reduction = noise_reduction;
+
+  uint32_t seed = 1;
+  double sum = 0;
+  uint32_t count = 0;
+  const uint32_t frames = 2000u*256u/fft_size;
+  for(uint32_t j=0; j<frames; ++j)
+  {
+    int16_t i[fft_size/2];
+    int16_t q[fft_size/2];
+    for(uint16_t idx = 0; idx<fft_size/2; ++idx)
+    {
+      seed = seed * 1103515245u + 12345u;
+      i[idx] = (int16_t)(seed >> 16) >> 6;
+      seed = seed * 1103515245u + 12345u;
+      q[idx] = (int16_t)(seed >> 16) >> 6;
+    }
+
+    filt->process_sample(i, q, fc, capture);
+
+    if(j < frames/2) continue;
+    for(uint16_t idx = 0; idx<new_fft_size/2; ++idx)
+    {
+      sum += (double)i[idx]*i[idx] + (double)q[idx]*q[idx];
+      count++;
+    }
+  }
+  delete filt;
+  return sqrt(sum/count);
+}
+
+//pass three steady carriers (one at a negative frequency) through the filter,
+//and return the rms output once the auto notch has had time to remove them
+template<uint8_t order>
+double filter_carriers(bool enable_auto_notch)
 {
+  static const uint16_t fft_size = fft_filter<order>::fft_size;
+  static const uint16_t new_fft_size = fft_filter<order>::new_fft_size;
+  fft_filter<order> *filt = new fft_filter<order>;
+  static int16_t capture[fft_size];
 
-  fft_filter filt;
+  s_filter_control fc;
+  fc.start_bin = 0;
+  fc.stop_bin = 32*(fft_size/256u);
+  fc.fft_bin = 0;
+  fc.upper_sideband = true;
+  fc.lower_sideband = true;
+  fc.capture = false;
+  fc.enable_auto_notch = enable_auto_notch;
+  fc.rotate_bins = false;
+  fc.noise_reduction = 0;
 
-  for(uint8_t j=0; j<4; ++j)
+  const double carriers[] = {20.0/256.0, -12.0/256.0, 7.0/256.0};
+  uint32_t t = 0;
+  double sum = 0;
+  uint32_t count = 0;
+  const uint32_t frames = 1000u*256u/fft_size;
+  for(uint32_t j=0; j<frames; ++j)
   {
-    int16_t i[128] = {0};
-    int16_t q[128] = {0};
-    uint32_t t = 0;
-    for(uint16_t idx = 0; idx<128; ++idx)
+    int16_t i[fft_size/2];
+    int16_t q[fft_size/2];
+    for(uint16_t idx = 0; idx<fft_size/2; ++idx)
     {
-      i[idx] = cos(8*2.0*M_PI*t/128.0)*2048*2;// + cos(10*2.0*M_PI*t/128.0)*2048;
-      q[idx] = 0; //sin(10*2.0*M_PI*t/2048.0) * 500;
+      double real = 0, imag = 0;
+      for(double carrier : carriers)
+      {
+        real += 150*cos(2.0*M_PI*carrier*t);
+        imag += 150*sin(2.0*M_PI*carrier*t);
+      }
+      i[idx] = real;
+      q[idx] = imag;
       t++;
     }
 
-    s_filter_control fc;
-    fc.start_bin = 0;
-    fc.stop_bin = 32;
-    fc.upper_sideband = true;
-    fc.lower_sideband = true;
-    fc.capture = false;
+    filt->process_sample(i, q, fc, capture);
+
+    if(j < frames/2) continue;
+    for(uint16_t idx = 0; idx<new_fft_size/2; ++idx)
+    {
+      sum += (double)i[idx]*i[idx] + (double)q[idx]*q[idx];
+      count++;
+    }
+  }
+  delete filt;
+  return sqrt(sum/count);
+}
+
+//pass a tone through the filter, and return the rms output of a dual watch
+//channel once settled, the main channel is tuned elsewhere
+template<uint8_t order>
+double filter_sub_channel(double cycles_per_sample, uint16_t rotation)
+{
+  static const uint16_t fft_size = fft_filter<order>::fft_size;
+  static const uint16_t new_fft_size = fft_filter<order>::new_fft_size;
+  fft_filter<order> *filt = new fft_filter<order>;
+  static int16_t capture[fft_size];
+
+  s_filter_control fc;
+  fc.start_bin = 0;
+  fc.stop_bin = 16*(fft_size/256u);
+  fc.fft_bin = 0;
+  fc.upper_sideband = true;
+  fc.lower_sideband = true;
+  fc.capture = false;
+  fc.enable_auto_notch = false;
+  fc.rotate_bins = true;
+  fc.noise_reduction = 0;
 
-    filt.process_sample(i, q, fc, NULL, NULL);
+  s_filter_control sub_fc = fc;
+  sub_fc.fft_bin = rotation;
 
-    for(uint16_t idx = 0; idx<64; ++idx)
+  uint32_t t = 0;
+  double sum = 0;
+  uint32_t count = 0;
+  for(uint8_t j=0; j<8; ++j)
+  {
+    int16_t i[fft_size/2];
+    int16_t q[fft_size/2];
+    for(uint16_t idx = 0; idx<fft_size/2; ++idx)
     {
-      printf("%u %i %i\n", idx, i[idx], q[idx]);
+      i[idx] = cos(2.0*M_PI*cycles_per_sample*t)*512;
+      q[idx] = sin(2.0*M_PI*cycles_per_sample*t)*512;
+      t++;
     }
+
+    filt->process_sample(i, q, fc, capture);
+    filt->process_sub_channel(i, q, sub_fc, rotation);
+
+    if(j < 2) continue;
+    for(uint16_t idx = 0; idx<new_fft_size/2; ++idx)
+    {
+      sum += (double)i[idx]*i[idx] + (double)q[idx]*q[idx];
+      count++;
+    }
+  }
+  delete filt;
+  return sqrt(sum/count);
+}
+
+//the same passband (in Hz) should pass and reject the same tones at every fft size
+template<uint8_t order>
+bool test_order()
+{
+  static const uint16_t bins_per_256 = (1u << order)/256u;
+  const double in_band = filter_tone<order>(8.0/256.0, 32*bins_per_256);
+  const double out_of_band = filter_tone<order>(48.0/256.0, 32*bins_per_256);
+  const bool pass = in_band > 100.0 && out_of_band < in_band/100.0;
+  printf("fft size %u: in band %.1f, out of band %.1f %s\n", 1u << order, in_band, out_of_band, pass?"pass":"FAIL");
+
+  //each noise reduction level should remove more noise than the last
+  bool nr_pass = true;
+  double last_noise = filter_noise<order>(0);
+  printf("fft size %u: noise reduction off, noise %.1f\n", 1u << order, last_noise);
+  for(uint8_t level = 1; level <= 3; ++level)
+  {
+    const double noise = filter_noise<order>(level);
+    nr_pass &= noise < last_noise * 0.9;
+    printf("fft size %u: noise reduction %u, noise %.1f\n", 1u << order, level, noise);
+    last_noise = noise;
   }
+  nr_pass &= last_noise < filter_noise<order>(0) * 0.5;
+  printf("fft size %u: noise reduction %s\n", 1u << order, nr_pass?"pass":"FAIL");
 
+  //all three carriers should be notched
+  const double carriers = filter_carriers<order>(false);
+  const double notched = filter_carriers<order>(true);
+  const bool notch_pass = notched < carriers * 0.05;
+  printf("fft size %u: carriers %.1f, with auto notch %.1f %s\n", 1u << order, carriers, notched, notch_pass?"pass":"FAIL");
+
+  //a dual watch channel (with an odd rotation, so that alternate frames are
+  //negated) should pick out a tone well away from the main channel
+  const uint16_t rotation = 41*bins_per_256;
+  const double watched = filter_sub_channel<order>(48.0/256.0, rotation + 1);
+  const double not_watched = filter_sub_channel<order>(8.0/256.0, rotation + 1);
+  const double main_channel = filter_tone<order>(48.0/256.0, 16*bins_per_256);
+  const bool sub_pass = watched > 100.0 && not_watched < watched/100.0 && main_channel < watched/100.0;
+  printf("fft size %u: dual watch %.1f, not watched %.1f %s\n", 1u << order, watched, not_watched, sub_pass?"pass":"FAIL");
+
+  return pass && nr_pass && notch_pass && sub_pass;
+}
+
+int main()
+{
+  bool pass = true;
+  pass &= test_order<8>();
+  pass &= test_order<9>();
+  pass &= test_order<10>();
+  return pass ? 0 : 1;
 }
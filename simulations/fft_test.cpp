@@ -0,0 +1,106 @@
+//Check the radix-4 fixed point fft against a double precision dft, and
+//against the original radix-2 implementation it replaced.
+
+#include "fft.h"
+#include <cstdio>
+#include <cmath>
+
+static int16_t reference_product(int16_t a, int16_t b)
+{
+  return ((int32_t)b * a + (1 << (fft_fraction_bits - 1))) >> fft_fraction_bits;
+}
+
+//the original radix-2 decimation in time fft, losing 1 bit every second stage
+static void reference_fft(int16_t reals[], int16_t imaginaries[], unsigned m)
+{
+  const unsigned n = 1 << m;
+  for (unsigned i = 0; i < n; i++) {
+    unsigned ip = 0;
+    for (unsigned bit = 0; bit < m; bit++) if (i & (1u << bit)) ip |= 1u << (m - bit - 1);
+    if (i < ip) {
+      int16_t t = reals[i]; reals[i] = reals[ip]; reals[ip] = t;
+      t = imaginaries[i]; imaginaries[i] = imaginaries[ip]; imaginaries[ip] = t;
+    }
+  }
+  for (unsigned stage = 0; stage < m; stage++) {
+    const unsigned subdft_size = 2 << stage;
+    const unsigned span = subdft_size >> 1;
+    for (unsigned j = 0; j < span; j++) {
+      const double angle = M_PI * j / span;
+      const int16_t real_twiddle = round(cos(angle) * (1 << fft_fraction_bits));
+      const int16_t imaginary_twiddle = -round(sin(angle) * (1 << fft_fraction_bits));
+      for (unsigned i = j; i < n; i += subdft_size) {
+        const unsigned ip = i + span;
+        const int16_t temp_real = reference_product(reals[ip], real_twiddle) - reference_product(imaginaries[ip], imaginary_twiddle);
+        const int16_t temp_imaginary = reference_product(reals[ip], imaginary_twiddle) + reference_product(imaginaries[ip], real_twiddle);
+        reals[ip] = reals[i] - temp_real;
+        imaginaries[ip] = imaginaries[i] - temp_imaginary;
+        reals[i] = reals[i] + temp_real;
+        imaginaries[i] = imaginaries[i] + temp_imaginary;
+        if (stage & 1) {
+          reals[ip] /= 2; imaginaries[ip] /= 2;
+          reals[i] /= 2; imaginaries[i] /= 2;
+        }
+      }
+    }
+  }
+}
+
+//rms error against a dft with the same scaling
+static double rms_error(const int16_t in_real[], const int16_t in_imag[], const int16_t out_real[], const int16_t out_imag[], unsigned m)
+{
+  const unsigned n = 1 << m;
+  const double scale = 1.0 / (1 << (m/2));
+  double sum = 0;
+  for (unsigned k = 0; k < n; k++) {
+    double real = 0, imag = 0;
+    for (unsigned t = 0; t < n; t++) {
+      const double angle = -2.0 * M_PI * ((k * t) % n) / n;
+      real += in_real[t] * cos(angle) - in_imag[t] * sin(angle);
+      imag += in_real[t] * sin(angle) + in_imag[t] * cos(angle);
+    }
+    const double error_real = out_real[k] - real * scale;
+    const double error_imag = out_imag[k] - imag * scale;
+    sum += error_real * error_real + error_imag * error_imag;
+  }
+  return sqrt(sum / n);
+}
+
+template <unsigned m>
+bool test_size()
+{
+  const unsigned n = 1 << m;
+  int16_t in_real[n], in_imag[n];
+  int16_t real[n], imag[n];
+  int16_t ref_real[n], ref_imag[n];
+
+  //a couple of tones and some noise
+  uint32_t seed = 12345;
+  for (unsigned t = 0; t < n; t++) {
+    seed = seed * 1103515245u + 12345u;
+    const double noise = (int16_t)(seed >> 16) / 64.0;
+    in_real[t] = 1000.0 * cos(2.0 * M_PI * 9.0 * t / n) + 300.0 * cos(2.0 * M_PI * 37.3 * t / n) + noise;
+    in_imag[t] = 1000.0 * sin(2.0 * M_PI * 9.0 * t / n) - 300.0 * sin(2.0 * M_PI * 37.3 * t / n) - noise;
+    real[t] = ref_real[t] = in_real[t];
+    imag[t] = ref_imag[t] = in_imag[t];
+  }
+
+  fixed_fft<m>(real, imag);
+  reference_fft(ref_real, ref_imag, m);
+
+  const double error = rms_error(in_real, in_imag, real, imag, m);
+  const double ref_error = rms_error(in_real, in_imag, ref_real, ref_imag, m);
+  const bool pass = error < 2.0 && error <= ref_error;
+  printf("fft size %u: rms error %.3f (radix-2 %.3f) %s\n", n, error, ref_error, pass?"pass":"FAIL");
+  return pass;
+}
+
+int main()
+{
+  bool pass = true;
+  pass &= test_size<7>();
+  pass &= test_size<8>();
+  pass &= test_size<9>();
+  pass &= test_size<10>();
+  return pass ? 0 : 1;
+}
@@ -0,0 +1,132 @@
+//Compare the division free FM discriminator (phase_difference) with the one
+//it replaced, which differentiated rectangular_2_phase. Both demodulate
+//synthetic FM signals, a tone at a range of deviations and signal to noise
+//ratios, and the SINAD of each is measured by fitting the tone.
+
+#include "utils.h"
+#include <cstdio>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+
+static const double sample_rate = 15625.0;
+static const double tone_Hz = 1000.0;
+static const uint32_t num_samples = 8192;
+
+static uint32_t seed = 1;
+
+//roughly gaussian, from the sum of 4 uniform values
+static double noise(double sigma)
+{
+  double sum = 0;
+  for(uint8_t i=0; i<4; ++i)
+  {
+    seed = seed * 1103515245u + 12345u;
+    sum += ((seed >> 16) & 0x7fff) / 32768.0 - 0.5;
+  }
+  return sum * sigma * sqrt(3.0);
+}
+
+//ratio of the power of the tone to everything else, in dB
+static double sinad(const int16_t audio[])
+{
+  //least squares fit of the tone (and DC), skipping the first samples
+  const uint32_t start = 64;
+  double ss = 0, sc = 0, cc = 0, ys = 0, yc = 0, mean = 0;
+  for(uint32_t n = start; n < num_samples; ++n) mean += audio[n];
+  mean /= num_samples - start;
+  for(uint32_t n = start; n < num_samples; ++n)
+  {
+    const double s = sin(2.0*M_PI*tone_Hz*n/sample_rate);
+    const double c = cos(2.0*M_PI*tone_Hz*n/sample_rate);
+    const double y = audio[n] - mean;
+    ss += s*s; sc += s*c; cc += c*c; ys += y*s; yc += y*c;
+  }
+  const double det = ss*cc - sc*sc;
+  const double a = (ys*cc - yc*sc)/det;
+  const double b = (yc*ss - ys*sc)/det;
+  double signal = 0, residual = 0;
+  for(uint32_t n = start; n < num_samples; ++n)
+  {
+    const double fit = a*sin(2.0*M_PI*tone_Hz*n/sample_rate) + b*cos(2.0*M_PI*tone_Hz*n/sample_rate);
+    const double y = audio[n] - mean;
+    signal += fit*fit;
+    residual += (y - fit)*(y - fit);
+  }
+  return 10.0*log10(signal/residual);
+}
+
+static bool test(double deviation_Hz, double amplitude, double noise_sigma)
+{
+  static int16_t old_audio[num_samples];
+  static int16_t new_audio[num_samples];
+  int16_t last_phase = 0;
+  int16_t last_i = 0, last_q = 0;
+  double phase = 0.3;
+  uint32_t max_difference = 0;
+  for(uint32_t n = 0; n < num_samples; ++n)
+  {
+    phase += 2.0*M_PI*deviation_Hz*sin(2.0*M_PI*tone_Hz*n/sample_rate)/sample_rate;
+    const int16_t i = lround(amplitude*cos(phase) + noise(noise_sigma));
+    const int16_t q = lround(amplitude*sin(phase) + noise(noise_sigma));
+
+    const int16_t this_phase = rectangular_2_phase(i, q);
+    old_audio[n] = this_phase - last_phase;
+    last_phase = this_phase;
+
+    new_audio[n] = phase_difference(i, q, last_i, last_q);
+    last_i = i;
+    last_q = q;
+
+    if(n) max_difference = std::max(max_difference, (uint32_t)abs((int16_t)(new_audio[n] - old_audio[n])));
+  }
+  const double old_sinad = sinad(old_audio);
+  const double new_sinad = sinad(new_audio);
+
+  //the old discriminator's error depends on the phase, about 0.07 radians
+  //(730) for each of the two phases, which bounds the differences from it
+  const bool pass = new_sinad >= old_sinad && max_difference < 1600;
+  printf("deviation %5.0f Hz, amplitude %5.0f, noise %4.0f: SINAD %5.1f dB (was %5.1f dB), max difference %4u %s\n",
+      deviation_Hz, amplitude, noise_sigma, new_sinad, old_sinad, (unsigned)max_difference, pass?"pass":"FAIL");
+  return pass;
+}
+
+int main()
+{
+  bool pass = true;
+
+  //accuracy over every angle, at a range of magnitudes
+  double max_error = 0;
+  for(double magnitude = 4; magnitude < 32768; magnitude *= 3.7)
+  {
+    for(uint16_t step = 0; step < 4096; ++step)
+    {
+      const double angle = 2.0*M_PI*step/4096 - M_PI;
+      const int16_t i = lround(magnitude*cos(angle));
+      const int16_t q = lround(magnitude*sin(angle));
+      //rectangular_2_phase measures clockwise from q, so (32767, 0) is at pi/2
+      const double expected = -atan2((double)q, (double)i) * 32768.0 / M_PI;
+      double error = fabs(phase_difference(i, q, 32767, 0) - expected);
+      if(error > 32768) error = 65536 - error;
+      if(magnitude > 100) max_error = std::max(max_error, error);
+    }
+  }
+  printf("phase_difference max error %.4f radians\n", max_error * M_PI / 32768.0);
+  pass &= max_error * M_PI / 32768.0 < 0.008;
+  pass &= phase_difference(0, 0, 100, 100) == 0 && phase_difference(100, 100, 0, 0) == 0;
+
+  //no overflow at full scale
+  pass &= abs(phase_difference(-32768, -32768, -32768, -32768)) < 100;
+  pass &= abs(phase_difference(32767, -32768, -32768, 32767) + 32768) < 100 || abs(phase_difference(32767, -32768, -32768, 32767) - 32767) < 100;
+
+  pass &= test(500, 8000, 0);
+  pass &= test(3000, 8000, 0);
+  pass &= test(5000, 20000, 0);
+  pass &= test(3000, 300, 0);
+  pass &= test(3000, 8000, 800);
+  pass &= test(3000, 8000, 3000);
+  pass &= test(5000, 2000, 400);
+
+  return pass ? 0 : 1;
+}
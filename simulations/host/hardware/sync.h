@@ -0,0 +1,15 @@
+//host shim for the parts of hardware/sync.h used by the firmware sources
+//only used when building with -DSIMULATION, see simulations/CMakeLists.txt
+
+#ifndef HOST_HARDWARE_SYNC_H
+#define HOST_HARDWARE_SYNC_H
+
+#include <atomic>
+
+//data memory barrier, orders memory accesses between threads
+static inline void __dmb(void)
+{
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+#endif
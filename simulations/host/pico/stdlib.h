@@ -0,0 +1,16 @@
+//host shim for the parts of pico/stdlib.h used by the DSP sources
+//only used when building with -DSIMULATION, see simulations/CMakeLists.txt
+
+#ifndef HOST_PICO_STDLIB_H
+#define HOST_PICO_STDLIB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+//there is no flash/ram distinction on the host
+#ifndef __not_in_flash_func
+#define __not_in_flash_func(func_name) func_name
+#endif
+
+#endif
@@ -0,0 +1,89 @@
+//Check that the dc and iq imbalance estimates saved for a band carry on
+//where they left off once restored. One receiver only ever sees the first
+//band's signal, two others are retuned to a second band with a different
+//imbalance and dc offset in between. Back on the first band, the one that
+//restores its estimate must agree with the first straight away, while the
+//one that doesn't is still far off.
+
+#include "rx_dsp.h"
+#include "rx_definitions.h"
+#include <cstdio>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+
+static const uint32_t num_blocks = 320;
+
+static void make_block(uint16_t samples[], uint32_t block, double imbalance, int16_t dc)
+{
+  uint32_t seed = block * 2654435761u;
+  for(uint16_t idx=0; idx<adc_block_size; idx+=2)
+  {
+    const double t = (double)(block * adc_block_size + idx) / 2.0;
+    seed = seed * 1103515245u + 12345u;
+    const double noise = (((seed >> 16) & 0x7fff) / 32768.0 - 0.5) * 40.0;
+    samples[idx] = 2048 + dc + 600.0 * cos(2.0 * M_PI * 0.017 * t) + noise;
+    samples[idx+1] = 2048 - dc + 600.0 * imbalance * sin(2.0 * M_PI * 0.017 * t + 0.15) + noise;
+  }
+}
+
+static void run(rx_dsp &dsp, uint32_t first_block, uint32_t blocks, double imbalance, int16_t dc)
+{
+  static uint16_t samples[adc_block_size];
+  static int16_t audio[adc_block_size/decimation_rate];
+  for(uint32_t block = first_block; block < first_block + blocks; ++block)
+  {
+    make_block(samples, block, imbalance, dc);
+    dsp.process_block(samples, audio);
+  }
+}
+
+//largest difference of the coefficients, relative to 1.0 (32768), and of the dc
+static int32_t difference(const s_iq_dc_estimate &a, const s_iq_dc_estimate &b)
+{
+  int32_t worst = std::max(abs(a.iq_c1 - b.iq_c1), abs(a.iq_c2 - b.iq_c2)) >> 5;
+  worst = std::max(worst, (int32_t)abs(a.i_avg - b.i_avg));
+  return std::max(worst, (int32_t)abs(a.q_avg - b.q_avg));
+}
+
+int main()
+{
+  static rx_dsp stays;
+  static rx_dsp restored;
+  static rx_dsp not_restored;
+  stays.set_iq_correction(1);
+  restored.set_iq_correction(1);
+  not_restored.set_iq_correction(1);
+
+  run(stays, 0, num_blocks, 1.2, 40);
+  run(restored, 0, num_blocks, 1.2, 40);
+  run(not_restored, 0, num_blocks, 1.2, 40);
+  s_iq_dc_estimate band_1;
+  restored.get_iq_dc_estimate(band_1);
+
+  //the other band moves the estimates well away
+  run(restored, num_blocks, num_blocks, 0.8, -60);
+  run(not_restored, num_blocks, num_blocks, 0.8, -60);
+  s_iq_dc_estimate band_2;
+  restored.get_iq_dc_estimate(band_2);
+
+  //and back again, for as long as one dc average
+  const uint32_t blocks_back = 2048 / rx_dsp::iq_block_size;
+  restored.set_iq_dc_estimate(band_1);
+  run(stays, num_blocks, blocks_back, 1.2, 40);
+  run(restored, num_blocks, blocks_back, 1.2, 40);
+  run(not_restored, num_blocks, blocks_back, 1.2, 40);
+  s_iq_dc_estimate expected, with, without;
+  stays.get_iq_dc_estimate(expected);
+  restored.get_iq_dc_estimate(with);
+  not_restored.get_iq_dc_estimate(without);
+
+  const int32_t moved = difference(band_1, band_2);
+  const int32_t error_with = difference(expected, with);
+  const int32_t error_without = difference(expected, without);
+  printf("second band moves the estimate by %d, back on the first band it is out by %d restored, %d not restored\n",
+      (int)moved, (int)error_with, (int)error_without);
+  const bool pass = moved > 20 && error_with <= 2 && error_without > 10 * std::max(error_with, (int32_t)1);
+  printf("%s\n", pass?"pass":"FAIL");
+  return pass ? 0 : 1;
+}
@@ -0,0 +1,219 @@
+//Replay a raw ADC capture through the receiver DSP chain on a host PC
+//
+//The capture is a stream of little-endian 16-bit words, exactly as the ADC
+//DMA writes them into ping_samples/pong_samples: 12-bit samples with I on the
+//even words and Q on the odd words. Blocks are processed back to back as fast
+//as possible and the demodulated audio is written to a 16-bit mono WAV file.
+
+#include "rx_dsp.h"
+#include "rx_definitions.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+static const char *mode_names[] = {"AM", "AMS", "LSB", "USB", "FM", "CW"};
+
+static void usage(const char *name)
+{
+  fprintf(stderr, "usage: %s [options] capture.raw audio.wav\n", name);
+  fprintf(stderr, "  -m mode    AM, AMS, LSB, USB, FM or CW (default AM)\n");
+  fprintf(stderr, "  -b bw      bandwidth 0 (very narrow) to 4 (very wide) (default 2)\n");
+  fprintf(stderr, "  -o offset  tuned frequency relative to the NCO in Hz (default 0)\n");
+  fprintf(stderr, "  -a agc     AGC setting 0-3, or 4-14 for manual gain (default 3)\n");
+  fprintf(stderr, "  -l         AGC with look ahead\n");
+  fprintf(stderr, "  -g dB      gain calibration in dB (default 62)\n");
+  fprintf(stderr, "  -q level   squelch 0-12 (default 0)\n");
+  fprintf(stderr, "  -d deemph  de-emphasis 0=off, 1=50us, 2=75us (default 0)\n");
+  fprintf(stderr, "  -k Hz      CW sidetone frequency (default 1000)\n");
+  fprintf(stderr, "  -n         enable auto notch\n");
+  fprintf(stderr, "  -r level   noise reduction 0=off, 1-3=low to high (default 0)\n");
+  fprintf(stderr, "  -p level   noise blanker 0=off, 1-3=low to high (default 0)\n");
+  fprintf(stderr, "  -s         swap I and Q\n");
+  fprintf(stderr, "  -c         enable IQ imbalance correction\n");
+  fprintf(stderr, "  -t         tune with the time domain mixer rather than the fft filter\n");
+  fprintf(stderr, "  -w offset  dual watch a second frequency relative to the NCO in Hz,\n");
+  fprintf(stderr, "             written as the right channel of a stereo wav\n");
+}
+
+static void write_le16(FILE *f, uint16_t x)
+{
+  const uint8_t b[2] = {(uint8_t)x, (uint8_t)(x >> 8)};
+  fwrite(b, 1, 2, f);
+}
+
+static void write_le32(FILE *f, uint32_t x)
+{
+  write_le16(f, x & 0xffff);
+  write_le16(f, x >> 16);
+}
+
+static void write_wav_header(FILE *f, uint32_t sample_rate, uint16_t channels, uint32_t data_bytes)
+{
+  fwrite("RIFF", 1, 4, f);
+  write_le32(f, 36 + data_bytes);
+  fwrite("WAVEfmt ", 1, 8, f);
+  write_le32(f, 16);              //fmt chunk size
+  write_le16(f, 1);               //PCM
+  write_le16(f, channels);
+  write_le32(f, sample_rate);
+  write_le32(f, sample_rate * channels * 2); //byte rate
+  write_le16(f, channels * 2);               //block align
+  write_le16(f, 16);              //bits per sample
+  fwrite("data", 1, 4, f);
+  write_le32(f, data_bytes);
+}
+
+int main(int argc, char *argv[])
+{
+  uint8_t mode = AM;
+  uint8_t bandwidth = 2;
+  double offset_Hz = 0.0;
+  uint8_t agc_speed = 3;
+  bool agc_look_ahead = false;
+  uint16_t gain_cal = 62;
+  uint8_t squelch = 0;
+  uint8_t deemphasis = 0;
+  uint16_t cw_sidetone_Hz = 1000;
+  bool auto_notch = false;
+  uint8_t noise_reduction = 0;
+  uint8_t noise_blanker = 0;
+  bool swap_iq = false;
+  bool iq_correction = false;
+  bool fft_frequency_shift = true;
+  bool dual_watch = false;
+  double dual_watch_offset_Hz = 0.0;
+
+  int opt;
+  while((opt = getopt(argc, argv, "m:b:o:a:lg:q:d:k:nr:p:sctw:h")) != -1)
+  {
+    switch(opt)
+    {
+      case 'm':
+      {
+        bool found = false;
+        for(uint8_t idx=0; idx<6; ++idx)
+        {
+          if(strcasecmp(optarg, mode_names[idx]) == 0)
+          {
+            mode = idx;
+            found = true;
+          }
+        }
+        if(!found)
+        {
+          fprintf(stderr, "unknown mode %s\n", optarg);
+          return 1;
+        }
+        break;
+      }
+      case 'b': bandwidth = atoi(optarg); break;
+      case 'o': offset_Hz = atof(optarg); break;
+      case 'a': agc_speed = atoi(optarg); break;
+      case 'l': agc_look_ahead = true; break;
+      case 'g': gain_cal = atoi(optarg); break;
+      case 'q': squelch = atoi(optarg); break;
+      case 'd': deemphasis = atoi(optarg); break;
+      case 'k': cw_sidetone_Hz = atoi(optarg); break;
+      case 'n': auto_notch = true; break;
+      case 'r': noise_reduction = atoi(optarg); break;
+      case 'p': noise_blanker = atoi(optarg); break;
+      case 's': swap_iq = true; break;
+      case 'c': iq_correction = true; break;
+      case 't': fft_frequency_shift = false; break;
+      case 'w': dual_watch = true; dual_watch_offset_Hz = atof(optarg); break;
+      default:
+        usage(argv[0]);
+        return opt == 'h' ? 0 : 1;
+    }
+  }
+
+  if(argc - optind != 2 || bandwidth > 4 || agc_speed > 14 || squelch > 12 || deemphasis > 2)
+  {
+    usage(argv[0]);
+    return 1;
+  }
+
+  FILE *input = fopen(argv[optind], "rb");
+  if(!input)
+  {
+    perror(argv[optind]);
+    return 1;
+  }
+
+  FILE *output = fopen(argv[optind + 1], "wb");
+  if(!output)
+  {
+    perror(argv[optind + 1]);
+    fclose(input);
+    return 1;
+  }
+
+  //apply settings in the same order as rx::apply_settings
+  static rx_dsp rx_dsp_inst;
+  rx_dsp_inst.set_fft_frequency_shift(fft_frequency_shift);
+  rx_dsp_inst.set_frequency_offset_Hz(offset_Hz);
+  rx_dsp_inst.set_cw_sidetone_Hz(cw_sidetone_Hz);
+  rx_dsp_inst.set_gain_cal_dB(gain_cal);
+  rx_dsp_inst.set_agc_speed(agc_speed);
+  rx_dsp_inst.set_agc_look_ahead(agc_look_ahead);
+  rx_dsp_inst.set_auto_notch(auto_notch);
+  rx_dsp_inst.set_noise_reduction(noise_reduction);
+  rx_dsp_inst.set_noise_blanker(noise_blanker);
+  rx_dsp_inst.set_mode(mode, bandwidth);
+  rx_dsp_inst.set_deemphasis(deemphasis);
+  rx_dsp_inst.set_squelch(squelch);
+  rx_dsp_inst.set_swap_iq(swap_iq);
+  rx_dsp_inst.set_iq_correction(iq_correction);
+  rx_dsp_inst.set_dual_watch(dual_watch, dual_watch_offset_Hz);
+
+  const uint32_t output_sample_rate = adc_sample_rate/decimation_rate;
+  const uint16_t channels = dual_watch ? 2 : 1;
+  write_wav_header(output, output_sample_rate, channels, 0);
+
+  uint8_t raw[adc_block_size * 2];
+  uint16_t samples[adc_block_size];
+  int16_t audio[adc_block_size/decimation_rate];
+  int16_t dual_watch_audio[adc_block_size/decimation_rate];
+  uint32_t num_blocks = 0;
+  uint32_t num_audio_samples = 0;
+  std::chrono::steady_clock::duration busy_time{0};
+
+  //a trailing partial block is discarded
+  while(fread(raw, sizeof(raw), 1, input) == 1)
+  {
+    for(uint16_t idx=0; idx<adc_block_size; ++idx)
+    {
+      samples[idx] = (raw[2*idx] | (raw[2*idx+1] << 8)) & 0xfff;
+    }
+
+    const auto start_time = std::chrono::steady_clock::now();
+    const uint16_t num_samples = rx_dsp_inst.process_block(samples, audio, dual_watch ? dual_watch_audio : nullptr);
+    busy_time += std::chrono::steady_clock::now() - start_time;
+
+    for(uint16_t idx=0; idx<num_samples; ++idx)
+    {
+      write_le16(output, audio[idx]);
+      if(dual_watch) write_le16(output, dual_watch_audio[idx]);
+    }
+    num_audio_samples += num_samples;
+    num_blocks++;
+  }
+
+  //go back and fill in the sizes now they are known
+  fseek(output, 0, SEEK_SET);
+  write_wav_header(output, output_sample_rate, channels, num_audio_samples * channels * 2);
+  fclose(output);
+  fclose(input);
+
+  const double busy_s = std::chrono::duration<double>(busy_time).count();
+  const double capture_s = (double)num_blocks * adc_block_size / adc_sample_rate;
+  fprintf(stderr, "%u blocks, %.3f s of capture processed in %.3f s (%.1fx real time)\n",
+      num_blocks, capture_s, busy_s, busy_s > 0.0 ? capture_s/busy_s : 0.0);
+  fprintf(stderr, "signal strength %i dBm\n", rx_dsp_inst.get_signal_strength_dBm());
+  if(noise_blanker) fprintf(stderr, "noise blanker %u impulses\n", (unsigned)rx_dsp_inst.get_noise_blanker_impulses());
+
+  return 0;
+}
@@ -0,0 +1,52 @@
+//Check that the load shedder steps down the ladder when processing can't keep
+//up, stays within the allowed steps, and restores features once there is
+//headroom again.
+
+#include "load_shedder.h"
+#include <cstdio>
+
+static const uint32_t block_time = 4266;
+
+//run a number of blocks at a fixed load, returns the final level
+static uint8_t run(load_shedder &shedder, uint32_t blocks, uint32_t busy_percent, bool missed = false)
+{
+  for(uint32_t block = 0; block < blocks; ++block)
+  {
+    shedder.update(block_time * busy_percent / 100, block_time, missed);
+  }
+  return shedder.get_level();
+}
+
+static bool check(const char *name, bool pass)
+{
+  printf("%s %s\n", name, pass?"pass":"FAIL");
+  return pass;
+}
+
+int main()
+{
+  bool pass = true;
+
+  {
+    load_shedder shedder;
+    shedder.set_max_level(num_shed_levels - 1);
+    pass &= check("light load sheds nothing", run(shedder, 5000, 50) == shed_none && shedder.get_deadline_misses() == 0);
+    pass &= check("one missed deadline sheds one step", run(shedder, 1, 50, true) == shed_auto_notch && shedder.get_deadline_misses() == 1);
+    pass &= check("steps wait for the load to settle", run(shedder, 60, 50, true) == shed_auto_notch);
+    pass &= check("sustained overload sheds everything allowed", run(shedder, 1000, 99) == shed_spectrum);
+    pass &= check("moderate load restores nothing", run(shedder, 5000, 80) == shed_spectrum);
+    pass &= check("headroom restores one step at a time", run(shedder, 1200, 30) == shed_iq_estimation);
+    pass &= check("all features restored", run(shedder, 5000, 30) == shed_none);
+  }
+
+  {
+    load_shedder shedder;
+    pass &= check("off by default", run(shedder, 1000, 99, true) == shed_none && shedder.get_deadline_misses() == 1000);
+    shedder.set_max_level(shed_auto_notch);
+    pass &= check("limited to the allowed steps", run(shedder, 1000, 99, true) == shed_auto_notch);
+    shedder.set_max_level(shed_none);
+    pass &= check("lowering the limit restores features", shedder.get_level() == shed_none);
+  }
+
+  return pass ? 0 : 1;
+}
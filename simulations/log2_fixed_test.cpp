@@ -0,0 +1,99 @@
+//Check the fixed point log2 against the float library, and that the spectrum
+//scaling, dB10 and signal strength in rx_dsp, which use it, stay within one
+//display step of the float versions they replaced.
+
+#include "utils.h"
+#include "rx_definitions.h"
+#include <cstdio>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+
+static bool check(const char *name, bool pass)
+{
+  printf("%s %s\n", name, pass?"pass":"FAIL");
+  return pass;
+}
+
+//as rx_dsp::get_spectrum did it with floats
+static uint8_t float_scale(uint16_t magnitude, uint16_t min, uint16_t max)
+{
+  const float logmin = log10f(min);
+  const float logmax = log10f(max);
+  const float normalised = 255.0f*(log10f(magnitude)-logmin)/(logmax-logmin);
+  return std::max(std::min(normalised, 255.0f), 0.0f);
+}
+
+//as rx_dsp::get_spectrum does it now
+static uint8_t fixed_scale(uint16_t magnitude, uint16_t min, uint16_t max)
+{
+  const int32_t logmin = log2_fixed(min);
+  const int32_t logmax = log2_fixed(max);
+  const int32_t logrange = std::max(logmax - logmin, (int32_t)1);
+  const int32_t normalised = 255*((int32_t)log2_fixed(magnitude)-logmin)/logrange;
+  return std::max(std::min(normalised, (int32_t)255), (int32_t)0);
+}
+
+int main()
+{
+  bool pass = true;
+
+  //every 16 bit value, and a spread of larger ones
+  double max_error = 0;
+  for(uint32_t x = 1; x < 65536; ++x)
+  {
+    max_error = std::max(max_error, fabs(log2_fixed(x)/65536.0 - log2((double)x)));
+  }
+  for(uint32_t x = 65536; x < 0xfff00000u; x += x/1021 + 1)
+  {
+    max_error = std::max(max_error, fabs(log2_fixed(x)/65536.0 - log2((double)x)));
+  }
+  printf("log2 max error %.6f\n", max_error);
+  pass &= check("log2 accuracy", max_error < 0.0002 && log2_fixed(0) == 0 && log2_fixed(1) == 0 && log2_fixed(0x80000000u) == (31u << 16));
+
+  //spectrum points, over the range of long term minimum and maximum
+  const uint16_t mins[] = {1, 3, 20, 150, 900, 2400};
+  const uint16_t maxs[] = {2500, 4000, 12000, 40000, 65523};
+  int32_t worst = 0;
+  for(uint16_t min : mins)
+  {
+    for(uint16_t max : maxs)
+    {
+      for(uint32_t magnitude = 1; magnitude < 65536; ++magnitude)
+      {
+        const int32_t difference = abs(fixed_scale(magnitude, min, max) - float_scale(magnitude, min, max));
+        worst = std::max(worst, difference);
+      }
+    }
+  }
+  printf("spectrum worst difference %d\n", (int)worst);
+  pass &= check("spectrum within one step", worst <= 1);
+
+  //dB10 for the ratios where the float version fits in a byte
+  worst = 0;
+  for(uint32_t ratio = 2; ratio < 65536; ++ratio)
+  {
+    const uint8_t float_dB10 = 256/(2*logf(ratio));
+    const uint32_t logratio = log2_fixed(ratio);
+    const uint8_t fixed_dB10 = std::min(12102203u/logratio, 255u);
+    worst = std::max(worst, (int32_t)abs(fixed_dB10 - float_dB10));
+  }
+  pass &= check("dB10 within one step", worst <= 1);
+
+  //signal strength, over the range of gain calibrations
+  worst = 0;
+  for(uint16_t gain_cal = 0; gain_cal <= 100; gain_cal += 10)
+  {
+    const int32_t offset = roundf(65536.0f*(full_scale_dBm - gain_cal - 20.0f*log10f(full_scale_signal_strength)));
+    for(int32_t amplitude = 1; amplitude < (1 << 18); amplitude += amplitude/64 + 1)
+    {
+      const int16_t float_dBm = roundf(full_scale_dBm - gain_cal + 20.0*log10f((float)amplitude / full_scale_signal_strength));
+      const uint32_t amplitude_dB = (log2_fixed(amplitude) * 1541u) >> 8;
+      const int16_t fixed_dBm = ((int32_t)amplitude_dB + offset + 32768) >> 16;
+      worst = std::max(worst, (int32_t)abs(fixed_dBm - float_dBm));
+    }
+  }
+  pass &= check("signal strength within 1dB", worst <= 1);
+
+  return pass ? 0 : 1;
+}
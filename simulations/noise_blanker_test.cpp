@@ -0,0 +1,86 @@
+//Check that the noise blanker leaves noise and signals alone, and finds and
+//removes impulses added to them.
+
+#include "noise_blanker.h"
+#include "rx_definitions.h"
+#include <cstdio>
+#include <cmath>
+#include <cstdlib>
+
+static uint32_t seed = 1;
+
+//roughly gaussian, from the sum of 4 uniform values
+static double noise(double sigma)
+{
+  double sum = 0;
+  for(uint8_t i=0; i<4; ++i)
+  {
+    seed = seed * 1103515245u + 12345u;
+    sum += ((seed >> 16) & 0x7fff) / 32768.0 - 0.5;
+  }
+  return sum * sigma * sqrt(3.0);
+}
+
+//fill a block with a tone in noise, returns the index of an impulse, or -1
+static int32_t make_block(uint16_t samples[], uint32_t block, bool add_impulse)
+{
+  for(uint16_t idx=0; idx<adc_block_size; idx+=2)
+  {
+    const double t = (double)(block * adc_block_size + idx) / 2.0;
+    samples[idx] = 2048 + 200.0 * cos(2.0 * M_PI * 0.01 * t) + noise(40.0);
+    samples[idx+1] = 2000 + 200.0 * sin(2.0 * M_PI * 0.01 * t) + noise(40.0);
+  }
+  if(!add_impulse) return -1;
+  seed = seed * 1103515245u + 12345u;
+  const int32_t position = 64 + (seed >> 16) % (adc_block_size - 128);
+  samples[position] = (block & 1) ? 4095 : 0;
+  return position;
+}
+
+static bool test_threshold(uint8_t threshold, uint32_t max_false_impulses)
+{
+  static uint16_t samples[adc_block_size];
+  noise_blanker blanker;
+  blanker.set_threshold(threshold);
+
+  //let the averages settle
+  for(uint32_t block=0; block<10; ++block)
+  {
+    make_block(samples, block, false);
+    blanker.process_block(samples);
+  }
+  const uint32_t settled_impulses = blanker.get_impulse_count();
+
+  //no impulses
+  for(uint32_t block=10; block<200; ++block)
+  {
+    make_block(samples, block, false);
+    blanker.process_block(samples);
+  }
+  const uint32_t false_impulses = blanker.get_impulse_count() - settled_impulses;
+
+  //one impulse per block, which must be removed
+  uint32_t missed = 0;
+  const uint32_t impulses_before = blanker.get_impulse_count();
+  for(uint32_t block=200; block<400; ++block)
+  {
+    const int32_t position = make_block(samples, block, true);
+    blanker.process_block(samples);
+    if(abs((int32_t)samples[position] - 2048 + (position & 1) * 48) > 400) missed++;
+  }
+  const uint32_t found = blanker.get_impulse_count() - impulses_before;
+
+  const bool pass = false_impulses <= max_false_impulses && missed == 0 && found >= 200 && found <= 200 + max_false_impulses;
+  printf("threshold %u: %u false impulses, %u of 200 impulses found, %u not removed, %u samples blanked %s\n",
+      threshold, (unsigned)false_impulses, (unsigned)found, (unsigned)missed, (unsigned)blanker.get_blanked_count(), pass?"pass":"FAIL");
+  return pass;
+}
+
+int main()
+{
+  bool pass = true;
+  pass &= test_threshold(10, 0);
+  pass &= test_threshold(7, 0);
+  pass &= test_threshold(5, 20);
+  return pass ? 0 : 1;
+}
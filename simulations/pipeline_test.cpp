@@ -0,0 +1,97 @@
+//Check the two stage pipeline used with DUAL_CORE_DSP. One thread runs the
+//front end of each block and queues the decimated IQ, as core 1 does, while
+//another runs the back end, as core 0 does. The front end thread solves the
+//iq imbalance correction after handing each block over, as rx::run does.
+//The audio must match an rx_dsp that runs process_block on one thread, and
+//every block must arrive once, complete and in order.
+
+#include "rx_dsp.h"
+#include "rx_definitions.h"
+#include "spsc_queue.h"
+#include <cstdio>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+static const uint32_t num_blocks = 400;
+static const uint16_t audio_block_size = adc_block_size/decimation_rate;
+
+struct s_iq_block
+{
+  uint32_t block;
+  int16_t real[rx_dsp::iq_block_size];
+  int16_t imag[rx_dsp::iq_block_size];
+};
+
+static void make_block(uint16_t samples[], uint32_t block)
+{
+  uint32_t seed = block * 2654435761u;
+  for(uint16_t idx=0; idx<adc_block_size; idx+=2)
+  {
+    const double t = (double)(block * adc_block_size + idx) / 2.0;
+    seed = seed * 1103515245u + 12345u;
+    const double noise = (((seed >> 16) & 0x7fff) / 32768.0 - 0.5) * 40.0;
+    samples[idx] = 2048 + 20 + 600.0 * cos(2.0 * M_PI * 0.013 * t) + noise;
+    samples[idx+1] = 2048 - 30 + 650.0 * sin(2.0 * M_PI * 0.013 * t + 0.1) + noise;
+  }
+}
+
+static void configure(rx_dsp &dsp)
+{
+  dsp.set_frequency_offset_Hz(2500.0);
+  dsp.set_mode(USB, 2);
+  dsp.set_auto_notch(true);
+  dsp.set_noise_reduction(1);
+  dsp.set_iq_correction(1);
+}
+
+int main()
+{
+  static rx_dsp single;
+  static rx_dsp pipelined;
+  static int16_t expected[num_blocks][audio_block_size];
+  static int16_t result[num_blocks][audio_block_size];
+  static spsc_queue<s_iq_block, 2> queue;
+  configure(single);
+  configure(pipelined);
+  pipelined.set_defer_iq_estimate(true);
+
+  for(uint32_t block = 0; block < num_blocks; ++block)
+  {
+    uint16_t samples[adc_block_size];
+    make_block(samples, block);
+    single.process_block(samples, expected[block]);
+  }
+
+  std::thread front_end([&]()
+  {
+    for(uint32_t block = 0; block < num_blocks; ++block)
+    {
+      uint16_t samples[adc_block_size];
+      make_block(samples, block);
+      s_iq_block *iq;
+      while(!(iq = queue.back())) std::this_thread::yield();
+      iq->block = block;
+      pipelined.process_front_end(samples, iq->real, iq->imag);
+      queue.push();
+      pipelined.update_iq_estimate();
+    }
+  });
+
+  uint32_t out_of_order = 0;
+  for(uint32_t expected_block = 0; expected_block < num_blocks; ++expected_block)
+  {
+    s_iq_block *iq;
+    while(!(iq = queue.front())) std::this_thread::yield();
+    out_of_order += iq->block != expected_block;
+    pipelined.process_back_end(iq->real, iq->imag, result[expected_block]);
+    queue.pop();
+  }
+  front_end.join();
+
+  const bool matches = memcmp(expected, result, sizeof(expected)) == 0;
+  const bool pass = matches && out_of_order == 0 && queue.empty();
+  printf("%u blocks, %u out of order, audio %s %s\n", (unsigned)num_blocks, (unsigned)out_of_order,
+      matches?"matches":"DIFFERS", pass?"pass":"FAIL");
+  return pass ? 0 : 1;
+}
@@ -0,0 +1,101 @@
+//Check that rx_dsp instances keep all of their state to themselves. Two
+//receivers with different settings process different signals, first each on
+//their own, then interleaved block by block. The audio and spectrum from the
+//interleaved pair must match the ones each gave on its own exactly.
+
+#include "rx_dsp.h"
+#include "rx_definitions.h"
+#include <cstdio>
+#include <cmath>
+#include <cstring>
+
+static const uint32_t num_blocks = 200;
+static const uint16_t audio_block_size = adc_block_size/decimation_rate;
+
+struct s_output
+{
+  int16_t audio[num_blocks][audio_block_size];
+  uint8_t spectrum[num_blocks/10][256];
+};
+
+//a tone with dc offsets and iq imbalance, so that every estimator has work to do
+static void make_block(uint16_t samples[], uint32_t block, double cycles_per_sample, double imbalance, int16_t dc)
+{
+  uint32_t seed = block * 2654435761u + (uint32_t)(cycles_per_sample * 1e6);
+  for(uint16_t idx=0; idx<adc_block_size; idx+=2)
+  {
+    const double t = (double)(block * adc_block_size + idx) / 2.0;
+    seed = seed * 1103515245u + 12345u;
+    const double noise = (((seed >> 16) & 0x7fff) / 32768.0 - 0.5) * 40.0;
+    samples[idx] = 2048 + dc + 600.0 * cos(2.0 * M_PI * cycles_per_sample * t) + noise;
+    samples[idx+1] = 2048 - dc + 600.0 * imbalance * sin(2.0 * M_PI * cycles_per_sample * t + 0.1) + noise;
+  }
+}
+
+static void configure(rx_dsp &dsp, bool first)
+{
+  dsp.set_frequency_offset_Hz(first ? 3000.0 : -7000.0);
+  dsp.set_agc_speed(first ? 0 : 2);
+  dsp.set_mode(first ? USB : FM, 2);
+  dsp.set_deemphasis(first ? 0 : 1);
+  dsp.set_auto_notch(first);
+  dsp.set_noise_reduction(first ? 2 : 0);
+  dsp.set_iq_correction(1);
+}
+
+static void process(rx_dsp &dsp, bool first, uint32_t block, s_output &output)
+{
+  static uint16_t samples[adc_block_size];
+  make_block(samples, block, first ? 0.01 : 0.023, first ? 1.1 : 0.9, first ? 30 : -50);
+  dsp.process_block(samples, output.audio[block], nullptr);
+  if(block % 10 == 9)
+  {
+    uint8_t dB10;
+    dsp.get_spectrum(output.spectrum[block/10], dB10);
+  }
+}
+
+int main()
+{
+  static rx_dsp alone[2];
+  static rx_dsp together[2];
+  static s_output expected[2];
+  static s_output result[2];
+
+  for(uint8_t channel = 0; channel < 2; ++channel)
+  {
+    configure(alone[channel], channel == 0);
+    configure(together[channel], channel == 0);
+  }
+
+  for(uint8_t channel = 0; channel < 2; ++channel)
+  {
+    for(uint32_t block = 0; block < num_blocks; ++block)
+    {
+      process(alone[channel], channel == 0, block, expected[channel]);
+    }
+  }
+
+  for(uint32_t block = 0; block < num_blocks; ++block)
+  {
+    for(uint8_t channel = 0; channel < 2; ++channel)
+    {
+      process(together[channel], channel == 0, block, result[channel]);
+    }
+  }
+
+  bool pass = true;
+  for(uint8_t channel = 0; channel < 2; ++channel)
+  {
+    const bool audio_matches = memcmp(expected[channel].audio, result[channel].audio, sizeof(expected[channel].audio)) == 0;
+    const bool spectrum_matches = memcmp(expected[channel].spectrum, result[channel].spectrum, sizeof(expected[channel].spectrum)) == 0;
+    printf("channel %u: audio %s, spectrum %s\n", channel, audio_matches?"matches":"DIFFERS", spectrum_matches?"matches":"DIFFERS");
+    pass &= audio_matches && spectrum_matches;
+  }
+
+  //and the two channels really are doing different things
+  pass &= memcmp(result[0].audio, result[1].audio, sizeof(result[0].audio)) != 0;
+
+  printf("%s\n", pass?"pass":"FAIL");
+  return pass ? 0 : 1;
+}
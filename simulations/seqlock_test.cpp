@@ -0,0 +1,51 @@
+//Check that a seqlock reader always sees a complete value while another
+//thread keeps writing, as core 0 and core 1 do with the settings and status.
+
+#include "seqlock.h"
+#include <cstdio>
+#include <thread>
+#include <atomic>
+
+//every field holds the same count, so a torn copy is easy to spot
+struct s_test_value
+{
+  uint32_t field[64];
+};
+
+int main()
+{
+  static seqlock<s_test_value> exchange;
+  std::atomic<bool> done(false);
+  const uint32_t num_writes = 200000;
+
+  std::thread writer([&]()
+  {
+    s_test_value value;
+    for(uint32_t count = 1; count <= num_writes; ++count)
+    {
+      for(uint32_t &field : value.field) field = count;
+      exchange.write(value);
+    }
+    done = true;
+  });
+
+  uint32_t reads = 0;
+  uint32_t torn = 0;
+  uint32_t out_of_order = 0;
+  uint32_t last_count = 0;
+  while(!done || last_count != num_writes)
+  {
+    s_test_value value;
+    exchange.read(value);
+    for(uint32_t field : value.field) torn += field != value.field[0];
+    out_of_order += value.field[0] < last_count;
+    last_count = value.field[0];
+    reads++;
+  }
+  writer.join();
+
+  const bool pass = torn == 0 && out_of_order == 0;
+  printf("%u reads of %u writes, %u torn, %u out of order %s\n",
+      (unsigned)reads, (unsigned)num_writes, (unsigned)torn, (unsigned)out_of_order, pass?"pass":"FAIL");
+  return pass ? 0 : 1;
+}
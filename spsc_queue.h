@@ -0,0 +1,59 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stdint.h>
+#include "hardware/sync.h"
+
+//Queue of items passed from one core to the other, one producer and one
+//consumer, without locks
+//
+//Items are filled and emptied in place, so nothing is copied. The producer
+//fills the item from back() then calls push(), the consumer uses the item
+//from front() then calls pop(). Each count is only written by one side, and
+//the barriers make sure an item is complete before the other side sees it.
+template <typename T, uint8_t depth>
+class spsc_queue
+{
+  static_assert((depth & (depth - 1)) == 0, "depth must be a power of 2");
+
+  volatile uint32_t pushed;
+  volatile uint32_t popped;
+  T items[depth];
+
+  public:
+  spsc_queue() : pushed(0), popped(0), items() {}
+
+  //producer: the next free item, or nullptr when the queue is full
+  T *back()
+  {
+    const uint32_t head = pushed;
+    if(head - popped >= depth) return nullptr;
+    __dmb();
+    return &items[head & (depth - 1)];
+  }
+
+  void push()
+  {
+    __dmb();
+    pushed = pushed + 1;
+  }
+
+  //consumer: the oldest item, or nullptr when the queue is empty
+  T *front()
+  {
+    const uint32_t tail = popped;
+    if(pushed == tail) return nullptr;
+    __dmb();
+    return &items[tail & (depth - 1)];
+  }
+
+  void pop()
+  {
+    __dmb();
+    popped = popped + 1;
+  }
+
+  bool empty() const { return pushed == popped; }
+};
+
+#endif
@@ -3,31 +3,25 @@
 
 int main()
 {
-  rx_dsp rx_dsp(10e3);
+  static rx_dsp rx_dsp_inst;
+  rx_dsp_inst.set_frequency_offset_Hz(10e3);
 
-  uint16_t samples[rx_dsp::block_size];
+  uint16_t samples[adc_block_size];
+  int16_t audio[adc_block_size/decimation_rate];
 
-  int16_t i[rx_dsp::block_size];
-  int16_t q[rx_dsp::block_size];
-
-  for(uint16_t idx=0; idx<rx_dsp::block_size; idx++)
+  for(uint16_t idx=0; idx<adc_block_size; idx++)
   {
       unsigned int sample;
-      scanf("%x", &sample);
+      if(scanf("%x", &sample) != 1) sample = 0;
       samples[idx] = sample;
   }
 
-  rx_dsp.process_block(samples, i, q);
-  const uint16_t num_output_samples = rx_dsp.process_block(samples, i, q);
+  rx_dsp_inst.process_block(samples, audio);
+  const uint16_t num_output_samples = rx_dsp_inst.process_block(samples, audio);
 
   for(uint16_t idx=0; idx<num_output_samples; idx++)
   {
-      if(q[idx] < 0){
-        printf("%0i%0ij, ", i[idx], q[idx]);
-      }
-      else{
-        printf("%0i+%0ij, ", i[idx], q[idx]);
-      }
+      printf("%i, ", audio[idx]);
   }
 
 }
@@ -17,7 +17,7 @@ data_raw = np.array(data_raw)*20+2048
 data_raw = " ".join([hex(int(i))[2:] for i in data_raw])
 print(data_raw)
 
-run(["g++", "rx_dsp.cpp", "test_dsp.cpp", "half_band_filter.cpp", "half_band_filter2.cpp", "-o", "test_dsp"])
+run(["g++", "-DSIMULATION", "-Isimulations/host", "rx_dsp.cpp", "fft_filter.cpp", "fft.cpp", "utils.cpp", "cic_corrections.cpp", "test_dsp.cpp", "-o", "test_dsp"])
 output = run("./test_dsp", input=bytes(data_raw, "utf8"), capture_output=True)
 error = output.stderr.decode("utf8").strip()
 for line in error.splitlines():
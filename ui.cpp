@@ -305,10 +305,9 @@ void ui::display_show()
 void ui::renderpage_original(rx_status & status, rx & receiver)
 {
 
-  receiver.access(false);
+  receiver.refresh_status();
   const float power_dBm = status.signal_strength_dBm;
   const float battery_voltage = 3.0f * 3.3f * (status.battery/65535.0f);
-  receiver.release();
 
   const uint8_t buffer_size = 21;
   char buff [buffer_size];
@@ -434,18 +433,49 @@ void ui::renderpage_waterfall(bool view_changed, rx_status & status, rx & receiv
 ////////////////////////////////////////////////////////////////////////////////
 void ui::renderpage_status(rx_status & status, rx & receiver)
 {
-  receiver.access(false);
+  receiver.refresh_status();
   const float battery_voltage = 3.0f * 3.3f * (status.battery/65535.0f);
   const float temp_voltage = 3.3f * (status.temp/65535.0f);
   const float temp = 27.0f - (temp_voltage - 0.706f)/0.001721f;
   const float block_time = (float)adc_block_size/(float)adc_sample_rate;
   const float busy_time = ((float)status.busy_time*1e-6f);
   const uint8_t usb_buf_level = status.usb_buf_level;
-  receiver.release();
+  const uint32_t noise_blanker_impulses = status.noise_blanker_impulses;
+  const uint32_t dma_overruns = status.dma_overruns;
+  const uint32_t dma_underruns = status.dma_underruns;
+  const uint32_t deadline_misses = status.deadline_misses;
+  const uint8_t shed_level = status.shed_level;
+#ifdef DSP_PROFILE
+  s_profile_stats profile[num_profile_stages];
+  for(uint8_t stage = 0; stage < num_profile_stages; ++stage) profile[stage] = status.profile[stage];
+  const uint32_t cycles_per_us = std::max(status.cycles_per_us, (uint32_t)1u);
+#endif
 
   display_clear();
   draw_slim_status(0, status, receiver);
 
+#ifdef DSP_PROFILE
+  //alternate with the time taken by each stage, every 4 seconds or so
+  if((time_us_32() >> 22) & 1u)
+  {
+    u8g2_SetDrawColor(&u8g2, 1);
+    u8g2_SetFont(&u8g2, u8g2_font_4x6_tf);
+    u8g2_DrawHLine(&u8g2, 0, 8, 128);
+    char line[33];
+    uint16_t y = 15;
+    u8g2_DrawStr(&u8g2, 0, y, "Stage     min   avg   max us");
+    for(uint8_t stage = 0; stage < num_profile_stages; ++stage)
+    {
+      y += 6;
+      snprintf(line, sizeof(line), "%-6s %6lu%6lu%6lu", profile_stage_names[stage],
+          profile[stage].min/cycles_per_us, profile[stage].avg/cycles_per_us, profile[stage].max/cycles_per_us);
+      u8g2_DrawStr(&u8g2, 0, y, line);
+    }
+    display_show();
+    return;
+  }
+#endif
+
   u8g2_SetDrawColor(&u8g2, 1);
   u8g2_SetFont(&u8g2, u8g2_font_6x10_tf);
   u8g2_DrawHLine(&u8g2, 0, 8, 128);
@@ -455,25 +485,35 @@ void ui::renderpage_status(rx_status & status, rx & receiver)
 
   //battery
   uint16_t y = 8; //draw from left
-  y += 10;
+  y += 9;
   snprintf(buff, buffer_size, "Battery : %2.1fV", battery_voltage);
   u8g2_DrawStr(&u8g2, 0, y, buff);
 
   //temp
-  y += 10;
+  y += 9;
   snprintf(buff, buffer_size, "CPU Temp: %2.0f%cC", temp, '\xb0');
   u8g2_DrawStr(&u8g2, 0, y, buff);
 
   //cpu load
-  y += 10;
-  snprintf(buff, buffer_size, "CPU Load: %3.0f%%", (100.0f * busy_time) / block_time);
+  y += 9;
+  snprintf(buff, buffer_size, "CPU Load: %3.0f%% Shed%u", (100.0f * busy_time) / block_time, shed_level);
   u8g2_DrawStr(&u8g2, 0, y, buff);
 
   //usb buffer
-  y += 10;
+  y += 9;
   snprintf(buff, buffer_size, "USB Buff: %3d%%", usb_buf_level);
   u8g2_DrawStr(&u8g2, 0, y, buff);
 
+  //noise blanker
+  y += 9;
+  snprintf(buff, buffer_size, "Blanked : %lu", noise_blanker_impulses);
+  u8g2_DrawStr(&u8g2, 0, y, buff);
+
+  //blocks lost by the adc/pwm dma ring, and blocks processed late
+  y += 9;
+  snprintf(buff, buffer_size, "O/U/Late: %lu/%lu/%lu", dma_overruns, dma_underruns, deadline_misses);
+  u8g2_DrawStr(&u8g2, 0, y, buff);
+
   display_show();
 }
 
@@ -496,9 +536,8 @@ void ui::renderpage_fun(bool view_updated, rx_status & status, rx & receiver)
 // Draw a slim 8 pixel status line
 void ui::draw_slim_status(uint16_t y, rx_status & status, rx & receiver)
 {
-  receiver.access(false);
+  receiver.refresh_status();
   const float power_dBm = status.signal_strength_dBm;
-  receiver.release();
 
   display_set_xy(0,y);
   display_print_freq(',', settings[idx_frequency],1);
@@ -702,9 +741,8 @@ void ui::renderpage_smeter(bool view_changed, rx_status & status, rx & receiver)
   static int dBm_ptr = 0;
   static float dBm_avg[NUM_DBM] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
 
-  receiver.access(false);
+  receiver.refresh_status();
   const float power_dBm = status.signal_strength_dBm;
-  receiver.release();
 
   dBm_avg[dBm_ptr++] = power_dBm;
   if (dBm_ptr >= NUM_DBM) dBm_ptr = 0;
@@ -1022,7 +1060,6 @@ bool ui::number_entry(const char title[], const char format[], int16_t min, int1
 //Apply settings
 void ui::apply_settings(bool suspend, bool settings_changed)
 {
-  receiver.access(settings_changed);
   settings_to_apply.tuned_frequency_Hz = settings[idx_frequency];
   settings_to_apply.agc_speed = settings[idx_agc_speed];
   settings_to_apply.enable_auto_notch = settings[idx_rx_features] >> flag_enable_auto_notch & 1;
@@ -1045,7 +1082,14 @@ void ui::apply_settings(bool suspend, bool settings_changed)
   settings_to_apply.band_7_limit = ((settings[idx_band2] >> 16) & 0xff);
   settings_to_apply.ppm = (settings[idx_hw_setup] & mask_ppm) >> flag_ppm;
   settings_to_apply.iq_correction = settings[idx_rx_features] >> flag_iq_correction & 1;
-  receiver.release();
+  settings_to_apply.noise_reduction = (settings[idx_rx_features] & mask_noise_reduction) >> flag_noise_reduction;
+  settings_to_apply.noise_blanker = (settings[idx_rx_features] & mask_noise_blanker) >> flag_noise_blanker;
+  settings_to_apply.agc_look_ahead = (settings[idx_rx_features] & mask_agc_look_ahead) >> flag_agc_look_ahead;
+  settings_to_apply.dual_watch = (settings[idx_rx_features] & mask_dual_watch) >> flag_dual_watch;
+  settings_to_apply.dual_watch_frequency_Hz = settings[idx_dual_watch_frequency];
+  settings_to_apply.dma_ring_depth = 2 << ((settings[idx_hw_setup] & mask_dma_ring_depth) >> flag_dma_ring_depth);
+  settings_to_apply.load_shedding = (settings[idx_hw_setup] & mask_load_shedding) >> flag_load_shedding;
+  receiver.publish_settings(settings_changed);
 }
 
 //remember settings across power cycles
@@ -1158,6 +1202,15 @@ void ui::autosave()
 
 }
 
+void ui::set_dual_watch(uint32_t settings[], uint32_t dual_watch)
+{
+  //watch the frequency that is tuned when dual watch is switched on
+  const bool was_on = (settings[idx_rx_features] & mask_dual_watch) != 0;
+  if(dual_watch && !was_on) settings[idx_dual_watch_frequency] = settings[idx_frequency];
+  settings[idx_rx_features] &= ~(mask_dual_watch);
+  settings[idx_rx_features] |= ((dual_watch << flag_dual_watch) & mask_dual_watch);
+}
+
 //remember settings across power cycles
 void ui::autorestore()
 {
@@ -1510,9 +1563,8 @@ bool ui::memory_recall(bool &ok)
   }
 
   //draw power meter
-  receiver.access(false);
+  receiver.refresh_status();
   int8_t power_dBm = status.signal_strength_dBm;
-  receiver.release();
   static float last_power_dBm = FLT_MAX;
   if(abs(power_dBm - last_power_dBm) > 1.0f)
   {
@@ -1568,9 +1620,8 @@ bool ui::memory_scan(bool &ok)
   {
 
     static float last_power_dBm = FLT_MAX;
-    receiver.access(false);
+    receiver.refresh_status();
     power_dBm = status.signal_strength_dBm;
-    receiver.release();
     update_display = abs(power_dBm - last_power_dBm) > 1.0f;
     listen = (power_dBm >= S_to_dBm(settings[idx_squelch]));
 
@@ -1771,9 +1822,8 @@ bool ui::frequency_scan(bool &ok)
   {
 
     static float last_power_dBm = FLT_MAX;
-    receiver.access(false);
+    receiver.refresh_status();
     power_dBm = status.signal_strength_dBm;
-    receiver.release();
     update_display = abs(power_dBm - last_power_dBm) > 1.0f;
     listen = (power_dBm >= S_to_dBm(settings[idx_squelch]));
 
@@ -2212,7 +2262,7 @@ bool ui::configuration_menu(bool &ok)
     //chose menu item
     if(ui_state == select_menu_item)
     {
-      if(menu_entry("HW Config", "Display\nTimeout#Regulator\nMode#Reverse\nEncoder#Encoder\nResolution#Swap IQ#Gain Cal#Freq Cal#Flip OLED#OLED Type#Display\nContrast#TFT\nSettings#TFT Colour#Bands#USB\nUpload#", &menu_selection, ok))
+      if(menu_entry("HW Config", "Display\nTimeout#Regulator\nMode#Reverse\nEncoder#Encoder\nResolution#Swap IQ#Gain Cal#Freq Cal#Flip OLED#OLED Type#Display\nContrast#TFT\nSettings#TFT Colour#Bands#Audio\nBuffers#Load\nShedding#USB\nUpload#", &menu_selection, ok))
       {
         if(ok) 
         {
@@ -2326,7 +2376,21 @@ bool ui::configuration_menu(bool &ok)
           done = bands_menu(ok);
           break;
 
-        case 13: 
+        case 13:
+          setting_word = (settings[idx_hw_setup] & mask_dma_ring_depth) >> flag_dma_ring_depth;
+          done = enumerate_entry("Audio\nBuffers", "2 Blocks#4 Blocks#", &setting_word, ok, changed);
+          settings[idx_hw_setup] &= ~mask_dma_ring_depth;
+          settings[idx_hw_setup] |= setting_word << flag_dma_ring_depth;
+          break;
+
+        case 14:
+          setting_word = (settings[idx_hw_setup] & mask_load_shedding) >> flag_load_shedding;
+          done = enumerate_entry("Load\nShedding", "Off#Notch#Notch+IQ#All#", &setting_word, ok, changed);
+          settings[idx_hw_setup] &= ~mask_load_shedding;
+          settings[idx_hw_setup] |= setting_word << flag_load_shedding;
+          break;
+
+        case 15: 
           setting_word = 0;
           enumerate_entry("USB Upload", "Back#Memory#Firmware#", &setting_word, ok, changed);
           if(setting_word==1) {
@@ -2360,7 +2424,7 @@ bool ui::main_menu(bool & ok)
     //chose menu item
     if(ui_state == select_menu_item)
     {
-      if(menu_entry("Menu", "Frequency#Recall#Store#Volume#Mode#AGC Speed#Bandwidth#Squelch#Auto Notch#De-\nEmphasis#IQ\nCorrection#Spectrum\nZoom#Band Start#Band Stop#Frequency\nStep#CW Tone\nFrequency#HW Config#", &menu_selection, ok))
+      if(menu_entry("Menu", "Frequency#Recall#Store#Volume#Mode#AGC Speed#AGC\nLook-ahead#Bandwidth#Squelch#Auto Notch#Noise\nReduction#Noise\nBlanker#Dual\nWatch#De-\nEmphasis#IQ\nCorrection#Spectrum\nZoom#Band Start#Band Stop#Frequency\nStep#CW Tone\nFrequency#HW Config#", &menu_selection, ok))
       {
         if(ok) 
         {
@@ -2407,51 +2471,78 @@ bool ui::main_menu(bool & ok)
             done = enumerate_entry("AGC Speed", "Fast#Normal#Slow#Very slow#0dB#6dB#12dB#18dB#24dB#30dB#36dB#42dB#48dB#54dB#60dB#", &settings[idx_agc_speed], ok, changed);
             if(changed) apply_settings(false);
             break;
-          case 6 :  
+          case 6 :
+            settings_word = (settings[idx_rx_features] & mask_agc_look_ahead) >> flag_agc_look_ahead;
+            done = enumerate_entry("AGC\nLook-ahead", "Off#On#", &settings_word, ok, changed);
+            settings[idx_rx_features] &= ~(mask_agc_look_ahead);
+            settings[idx_rx_features] |= ((settings_word << flag_agc_look_ahead) & mask_agc_look_ahead);
+            if(changed) apply_settings(false);
+            break;
+          case 7 :  
             settings_word = (settings[idx_bandwidth_spectrum] & mask_bandwidth) >> flag_bandwidth;
             done = enumerate_entry("Bandwidth", "V Narrow#Narrow#Normal#Wide#Very Wide#", &settings_word, ok, changed);
             settings[idx_bandwidth_spectrum] &= ~(mask_bandwidth);
             settings[idx_bandwidth_spectrum] |= ((settings_word << flag_bandwidth) & mask_bandwidth);
             if(changed) apply_settings(false);
             break;
-          case 7 :  
+          case 8 :  
             done = enumerate_entry("Squelch", "S0#S1#S2#S3#S4#S5#S6#S7#S8#S9#S9+10dB#S9+20dB#S9+30dB#", &settings[idx_squelch], ok, changed);
             if(changed) apply_settings(false);
             break;
-          case 8 :  
+          case 9 :  
             done = bit_entry("Auto Notch", "Off#On#", flag_enable_auto_notch, &settings[idx_rx_features], ok);
             break;
-          case 9 :
+          case 10 :
+            settings_word = (settings[idx_rx_features] & mask_noise_reduction) >> flag_noise_reduction;
+            done = enumerate_entry("Noise\nReduction", "Off#Low#Medium#High#", &settings_word, ok, changed);
+            settings[idx_rx_features] &= ~(mask_noise_reduction);
+            settings[idx_rx_features] |= ((settings_word << flag_noise_reduction) & mask_noise_reduction);
+            if(changed) apply_settings(false);
+            break;
+          case 11 :
+            settings_word = (settings[idx_rx_features] & mask_noise_blanker) >> flag_noise_blanker;
+            done = enumerate_entry("Noise\nBlanker", "Off#Low#Medium#High#", &settings_word, ok, changed);
+            settings[idx_rx_features] &= ~(mask_noise_blanker);
+            settings[idx_rx_features] |= ((settings_word << flag_noise_blanker) & mask_noise_blanker);
+            if(changed) apply_settings(false);
+            break;
+          case 12 :
+            settings_word = (settings[idx_rx_features] & mask_dual_watch) >> flag_dual_watch;
+            done = enumerate_entry("Dual\nWatch", "Off#USB Audio#Mix#", &settings_word, ok, changed);
+            set_dual_watch(settings, settings_word);
+            if(changed) apply_settings(false);
+            break;
+          case 13 :
             settings_word = (settings[idx_rx_features] & mask_deemphasis) >> flag_deemphasis;
             done = enumerate_entry("De-\nemphasis", "Off#50us#75us#", &settings_word, ok, changed);
             settings[idx_rx_features] &= ~(mask_deemphasis);
             settings[idx_rx_features] |= ((settings_word << flag_deemphasis) & mask_deemphasis);
             if(changed) apply_settings(false);
             break;
-          case 10 : 
+          case 14 : 
             done = bit_entry("IQ\ncorrection", "Off#On#", flag_iq_correction, &settings[idx_rx_features], ok);
             break;
-          case 11 : 
+          case 15 : 
             settings_word = (settings[idx_bandwidth_spectrum] & mask_spectrum) >> flag_spectrum;
             done = number_entry("Spectrum\nZoom Level", "%i", 1, 4, 1, (int32_t*)&settings_word, ok, changed);
             settings[idx_bandwidth_spectrum] &= ~(mask_spectrum);
             settings[idx_bandwidth_spectrum] |= ((settings_word << flag_spectrum) & mask_spectrum);
             break;
-          case 12 :  
+          case 16 :  
             done = frequency_entry("Band Start", idx_min_frequency, ok);
             break;
-          case 13 : 
+          case 17 : 
             done = frequency_entry("Band Stop", idx_max_frequency, ok);
             break;
-          case 14 : 
+          case 18 : 
             done = enumerate_entry("Frequency\nStep", "10Hz#50Hz#100Hz#1kHz#5kHz#9kHz#10kHz#12.5kHz#25kHz#50kHz#100kHz#", &settings[idx_step], ok, changed);
             settings[idx_frequency] -= settings[idx_frequency]%step_sizes[settings[idx_step]];
             break;
-          case 15 : 
+          case 19 : 
             done = number_entry("CW Tone\nFrequency", "%iHz", 1, 30, 100, (int32_t*)&settings[idx_cw_sidetone], ok, changed);
             if(changed) apply_settings(false);
             break;
-          case 16 : 
+          case 20 : 
             done = configuration_menu(ok);
             break;
         }
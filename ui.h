@@ -54,6 +54,7 @@ const uint8_t PIN_DISPLAY_SCL = 19;
 #define idx_rx_features 12
 #define idx_band1 13
 #define idx_band2 14
+#define idx_dual_watch_frequency 15
 
 // bit flags for HW settings in idx_hw_setup
 #define flag_reverse_encoder 0
@@ -69,6 +70,10 @@ const uint8_t PIN_DISPLAY_SCL = 19;
 #define flag_tft_colour 15   // bits 15
 #define mask_tft_colour (0x1 << flag_tft_colour)
 #define flag_encoder_res 16
+#define flag_dma_ring_depth 17   // bits 17-18, log2(ring depth) - 1
+#define mask_dma_ring_depth (0x3 << flag_dma_ring_depth)
+#define flag_load_shedding 19   // bits 19-20, highest e_shed_level allowed
+#define mask_load_shedding (0x3 << flag_load_shedding)
 #define flag_ppm 24   // bits 24-31
 #define mask_ppm (0xff << flag_ppm)
 
@@ -85,6 +90,14 @@ const uint8_t PIN_DISPLAY_SCL = 19;
 #define mask_deemphasis (0x3 << flag_deemphasis)
 #define flag_iq_correction (3)
 #define mask_iq_correction (0x1 << flag_iq_correction)
+#define flag_noise_reduction (4)
+#define mask_noise_reduction (0x3 << flag_noise_reduction)
+#define flag_noise_blanker (6)
+#define mask_noise_blanker (0x3 << flag_noise_blanker)
+#define flag_dual_watch (8)
+#define mask_dual_watch (0x3 << flag_dual_watch)
+#define flag_agc_look_ahead (10)
+#define mask_agc_look_ahead (0x1 << flag_agc_look_ahead)
 
 // define wait macros
 #define WAIT_10MS sleep_us(10000);
@@ -240,6 +253,9 @@ class ui
   public:
 
   uint32_t * get_settings(){return &settings[0];};
+  //set the dual watch mode (0 = off, 1 = usb audio, 2 = mix), the watched
+  //frequency is latched from the tuned frequency when it is switched on
+  static void set_dual_watch(uint32_t settings[], uint32_t dual_watch);
   void autorestore();
   void do_ui();
   ui(rx_settings & settings_to_apply, rx_status & status, rx &receiver, uint8_t *spectrum, uint8_t &dB10, waterfall &waterfall_inst);
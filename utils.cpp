@@ -1,6 +1,7 @@
 #include "utils.h"
 #include <cstdint>
 #include <math.h>
+#include <algorithm>
 
 int16_t sin_table[2048];
 
@@ -41,6 +42,66 @@ int16_t rectangular_2_phase(int16_t i, int16_t q)
    else return(angle);
 }
 
+s_reciprocal_table reciprocal_table;
+
+int16_t phase_difference(int16_t i, int16_t q, int16_t last_i, int16_t last_q)
+{
+  //conjugate product, halved so that it can't overflow. rectangular_2_phase
+  //measures angles clockwise from q, so the imaginary part is negated.
+  const int32_t re = (((int32_t)i * last_i) >> 1) + (((int32_t)q * last_q) >> 1);
+  const int32_t im = (((int32_t)i * last_q) >> 1) - (((int32_t)q * last_i) >> 1);
+  uint32_t absre = re < 0 ? -re : re;
+  uint32_t absim = im < 0 ? -im : im;
+  uint32_t larger = std::max(absre, absim);
+  uint32_t smaller = std::min(absre, absim);
+  if(larger == 0) return 0;
+
+  //scale the larger to 15 bits, then smaller/larger with 15 fraction bits
+  //from the reciprocal of the top 8 bits of the larger
+  const uint8_t msb = 31 - __builtin_clz(larger);
+  if(msb > 14)
+  {
+    larger >>= msb - 14;
+    smaller >>= msb - 14;
+  }
+  const uint8_t scaled_msb = std::min(msb, (uint8_t)14);
+  const uint32_t mantissa = scaled_msb >= 7 ? larger >> (scaled_msb - 7) : larger << (7 - scaled_msb);
+  const int32_t ratio = std::min((smaller * reciprocal_table.value[mantissa - 128u]) >> scaled_msb, (uint32_t)32768u);
+
+  //atan(r) ~ pi/4*r + 0.273*r*(1-r) for the first octant, pi = 32768
+  int32_t angle = (ratio * 8192 + ((((ratio * (32768 - ratio)) >> 15) * 2847))) >> 15;
+
+  //unfold the octants
+  if(absim > absre) angle = 16384 - angle;
+  if(re < 0) angle = 32768 - angle;
+  if(im < 0) angle = -angle;
+  return angle;
+}
+
+//log2(1 + k/32) with 16 fraction bits
+static const uint32_t log2_table[33] = {
+      0,  2909,  5732,  8473, 11136, 13727, 16248, 18704,
+  21098, 23433, 25711, 27936, 30109, 32234, 34312, 36346,
+  38336, 40286, 42196, 44068, 45904, 47705, 49472, 51207,
+  52911, 54584, 56229, 57845, 59434, 60997, 62534, 64047,
+  65536
+};
+
+uint32_t log2_fixed(uint32_t x)
+{
+  if(x == 0) return 0;
+
+  //integer part is the position of the msb, normalise the rest so that the
+  //msb is bit 31, the next 5 bits select the table entry and the 16 bits
+  //after that interpolate to the next one
+  const uint8_t msb = 31 - __builtin_clz(x);
+  const uint32_t mantissa = x << (31 - msb);
+  const uint8_t index = (mantissa >> 26) & 31;
+  const uint32_t fraction = (mantissa >> 10) & 0xffff;
+  const uint32_t step = log2_table[index + 1] - log2_table[index];
+  return ((uint32_t)msb << 16) + log2_table[index] + ((step * fraction) >> 16);
+}
+
 void initialise_luts()
 {
   //pre-generate sin/cos lookup tables
@@ -8,6 +8,29 @@ extern int16_t sin_table[2048];
 uint16_t rectangular_2_magnitude(int16_t i, int16_t q);
 //from: https://dspguru.com/dsp/tricks/fixed-point-atan2-with-self-normalization/
 int16_t rectangular_2_phase(int16_t i, int16_t q);
+//the change in rectangular_2_phase from (last_i, last_q) to (i, q), found
+//from their conjugate product. Division free, using reciprocal_table and a
+//quadratic arctangent (error < 0.005 radians).
+int16_t phase_difference(int16_t i, int16_t q, int16_t last_i, int16_t last_q);
+
+//1/(128 + k) with 22 fraction bits, to divide by values normalised to
+//128-255. Generated at compile time, and not const so that it is in RAM.
+struct s_reciprocal_table
+{
+  uint16_t value[128];
+  constexpr s_reciprocal_table() : value()
+  {
+    for(uint16_t k = 0; k < 128; ++k)
+    {
+      value[k] = (((1u << 23)/(128u + k)) + 1u) >> 1;
+    }
+  }
+};
+extern s_reciprocal_table reciprocal_table;
+
+//log2 with 16 fraction bits, using a count leading zeros and a 33 entry
+//table with linear interpolation, error < 0.0002. 0 for x = 0.
+uint32_t log2_fixed(uint32_t x);
 
 void initialise_luts();
 
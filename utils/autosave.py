@@ -15,6 +15,7 @@ import struct
 #define idx_bandwidth 11
 #define idx_rx_features 12
 #define idx_oled_contrast 13  // values 0..15 get * 17 for set_contrast(0.255)
+#define idx_dual_watch_frequency 15
 
 
 
@@ -70,7 +71,7 @@ class Memory:
         0x00000000,                          #c rx_features
         0x10080402,                          #d band limits 1 (125kHz steps)
         0x00804020,                          #e band limits 2 (125kHz steps)
-        0xffffffff,                          #f
+        int(frequency)&0xffffffff,           #f dual watch frequency
       ]
       self.memory.append(data)
 
@@ -300,9 +300,8 @@ void waterfall::update_spectrum(rx &receiver, rx_settings &settings, rx_status &
       const uint16_t smeter_height = 237-43;
       const uint16_t smeter_width = 24;
 
-      receiver.access(false);
+      receiver.refresh_status();
       const int16_t power_dBm = status.signal_strength_dBm;
-      receiver.release();
 
       static float filtered_power = power_dBm;
       filtered_power = (filtered_power * 0.7) + (power_dBm * 0.3);
@@ -365,7 +364,8 @@ void waterfall::update_spectrum(rx &receiver, rx_settings &settings, rx_status &
          const bool is_passband = is_usb_col || is_lsb_col;
 
          uint8_t heat = waterfall_buffer[row_address][col];
-         uint16_t colour=heatmap(heat, is_passband, fbin==0);
+         const bool is_cursor = (fbin==0) || (fbin==status.dual_watch_bin);
+         uint16_t colour=heatmap(heat, is_passband, is_cursor);
          line[col] = colour;
       }
       display->writeHLine(waterfall_x, waterfall_row+waterfall_y, num_cols, line);
@@ -390,6 +390,7 @@ void waterfall::update_spectrum(rx &receiver, rx_settings &settings, rx_status &
       const bool is_lsb_col = (-fbin > status.filter_config.start_bin) && (-fbin < status.filter_config.stop_bin) && status.filter_config.lower_sideband;
       const bool is_passband = is_usb_col || is_lsb_col;
       const bool col_is_tick = (fbin%42 == 0) && fbin;
+      const bool is_cursor = (fbin==0) || (fbin==status.dual_watch_bin);
 
 
       for(uint8_t row=0; row<scope_height; ++row)
@@ -397,7 +398,7 @@ void waterfall::update_spectrum(rx &receiver, rx_settings &settings, rx_status &
         const bool row_is_tick = (row%(4*scope_height*stored_dB10/270)) == 0;
         if(row < data_point)
         {
-          vline[scope_height - 1 - row] = heatmap((uint16_t)row*256/scope_height, is_passband, fbin==0);
+          vline[scope_height - 1 - row] = heatmap((uint16_t)row*256/scope_height, is_passband, is_cursor);
         }
         else if(row == data_point)
         {
@@ -405,7 +406,7 @@ void waterfall::update_spectrum(rx &receiver, rx_settings &settings, rx_status &
         }
         else
         {
-          uint16_t colour = heatmap(0, is_passband, fbin==0);
+          uint16_t colour = heatmap(0, is_passband, is_cursor);
           colour = col_is_tick?COLOUR_GRAY:colour;
           colour = row_is_tick?COLOUR_GRAY:colour;
           vline[scope_height - 1 - row] = colour;